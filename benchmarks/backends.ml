@@ -0,0 +1,114 @@
+(* Compare the root implementations on synthetic workloads.
+   Usage: backends.exe [max live roots] [operations per run]
+
+   Workloads:
+   - churn: create n roots and delete them, repeatedly;
+   - modify: modify n roots, alternately to young and old values;
+   - live: keep n roots to an old block alive and force collections;
+   - mix: replace the oldest of a window of n roots to young blocks,
+     while collections happen.
+   The sizes n go from 1K to [max live roots] by factors of 10. For
+   the live workload, the cost of collections and the scanning done
+   by the implementation are reported.
+
+   bitmap_boxroot and rem_boxroot are compiled according to
+   ENABLE_BOXROOT_MUTEX and ENABLE_BOXROOT_GENERATIONAL (default 1),
+   see backends.sh to run the four combinations. *)
+
+type backend =
+  | Boxroot
+  | Dll
+  | Bitmap
+  | Rem
+  | Arena
+
+type workload =
+  | Churn
+  | Modify
+  | Live
+  | Mix
+
+external run : backend -> workload -> int -> int -> int ref -> float array
+  = "bench_backend_run"
+
+let backend_name = function
+  | Boxroot -> "boxroot"
+  | Dll -> "dll_boxroot"
+  | Bitmap -> "bitmap_boxroot"
+  | Rem -> "rem_boxroot"
+  | Arena -> "arena"
+;;
+
+let workload_name = function
+  | Churn -> "churn"
+  | Modify -> "modify"
+  | Live -> "live"
+  | Mix -> "mix"
+;;
+
+let arg i default =
+  if Array.length Sys.argv > i then int_of_string Sys.argv.(i) else default
+;;
+
+let flag name =
+  match Sys.getenv_opt name with
+  | Some v -> v
+  | None -> "1"
+;;
+
+let () =
+  let max_live = arg 1 10_000_000 in
+  let ops = arg 2 10_000_000 in
+  Printf.printf
+    "ENABLE_BOXROOT_MUTEX=%s ENABLE_BOXROOT_GENERATIONAL=%s\n"
+    (flag "ENABLE_BOXROOT_MUTEX")
+    (flag "ENABLE_BOXROOT_GENERATIONAL");
+  Printf.printf
+    "%8s %10s %15s %9s %11s %11s %11s %11s %12s %12s\n"
+    "workload"
+    "roots"
+    "implementation"
+    "ns/op"
+    "minor (us)"
+    "major (us)"
+    "scan/minor"
+    "scan/major"
+    "work/minor"
+    "work/major";
+  let old = ref 0 in
+  List.iter
+    (fun w ->
+      let rec sizes n = if n > max_live then [] else n :: sizes (10 * n) in
+      List.iter
+        (fun n ->
+          (* The live workload forces collections, which cost
+             proportionally to n: fewer rounds. *)
+          let rounds =
+            match w with
+            | Live -> 10
+            | Mix -> ops
+            | Churn | Modify -> max 1 (ops / n)
+          in
+          List.iter
+            (fun b ->
+              Gc.full_major ();
+              let r = run b w n rounds old in
+              let us x = Printf.sprintf "%.1f" (x /. 1e3) in
+              let per_gc count x = if count = 0. then "-" else x in
+              Printf.printf
+                "%8s %10d %15s %9.1f %11s %11s %11s %11s %12s %12s\n%!"
+                (workload_name w)
+                n
+                (backend_name b)
+                r.(0)
+                (if w = Live then us r.(1) else "-")
+                (if w = Live then us r.(2) else "-")
+                (per_gc r.(3) (us r.(5)))
+                (per_gc r.(4) (us r.(6)))
+                (per_gc r.(3) (Printf.sprintf "%.0f" r.(7)))
+                (per_gc r.(4) (Printf.sprintf "%.0f" r.(8))))
+            [ Boxroot; Dll; Bitmap; Rem; Arena ])
+        (sizes 1000))
+    [ Churn; Modify; Live; Mix ];
+  ignore (Sys.opaque_identity old : int ref)
+;;
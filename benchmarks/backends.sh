@@ -0,0 +1,12 @@
+#!/bin/sh
+# Run benchmarks/backends.exe for each combination of the build flags
+# of bitmap_boxroot and rem_boxroot. Arguments are passed to
+# backends.exe. Run from the root of the repository.
+set -e
+for mutex in 1 0; do
+  for generational in 1 0; do
+    ENABLE_BOXROOT_MUTEX=$mutex ENABLE_BOXROOT_GENERATIONAL=$generational \
+      dune exec --release benchmarks/backends.exe -- "$@"
+    echo
+  done
+done
@@ -0,0 +1,224 @@
+/* SPDX-License-Identifier: MIT */
+#define CAML_NAME_SPACE
+
+#include <stdlib.h>
+#include <time.h>
+
+#include <caml/mlvalues.h>
+#include <caml/alloc.h>
+#include <caml/fail.h>
+#include <caml/memory.h>
+#include "../boxroot/boxroot.h"
+#include "../boxroot/dll_boxroot.h"
+#include "../boxroot/bitmap_boxroot.h"
+#include "../boxroot/rem_boxroot.h"
+#include "../boxroot/arena.h"
+
+/* Gc.minor, Gc.major */
+CAMLextern value caml_gc_minor(value);
+CAMLextern value caml_gc_major(value);
+
+static double now_ns(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)t.tv_sec * 1e9 + (double)t.tv_nsec;
+}
+
+/* An old block, registered by [bench_backend_run] */
+static value old_block = Val_unit;
+
+static inline value young_block(long i)
+{
+  value v = caml_alloc_small(1, 0);
+  Field(v, 0) = Val_long(i);
+  return v;
+}
+
+static inline void arena_modify(local_ref *r, value v)
+{
+  *local_get_ref(*r) = v;
+}
+
+/* Results of a workload, see [bench_backend_run] */
+typedef struct {
+  double ns_per_op;
+  double minor_ns; /* wall time per forced minor collection */
+  double major_ns; /* wall time per forced major collection */
+} result;
+
+/* The workloads, instantiated for each implementation so that their
+   fast paths are inlined. Each returns false if a creation failed,
+   leaving roots behind.
+   - churn: create [n] roots to immediates and delete them, [rounds]
+     times; per root.
+   - modify: modify [n] roots, alternately to a fresh young block and
+     to an old block, [rounds] times; per modification.
+   - live: create [n] roots to an old block, then force [rounds]
+     minor and [rounds] major collections; per creation, and per
+     collection.
+   - mix: replace the oldest of a window of [n] roots to young blocks
+     with a fresh one, [rounds] times, letting collections happen;
+     per replacement. */
+#define DEFINE_WORKLOADS(name, T, create, delete, modify)              \
+  static bool churn_##name(T *hs, long n, long rounds, result *res)     \
+  {                                                                     \
+    double start = now_ns();                                            \
+    for (long r = 0; r < rounds; r++) {                                 \
+      for (long i = 0; i < n; i++) {                                    \
+        hs[i] = create(Val_long(i));                                    \
+        if (hs[i] == NULL) return false;                                \
+      }                                                                 \
+      for (long i = 0; i < n; i++) delete(hs[i]);                       \
+    }                                                                   \
+    res->ns_per_op = (now_ns() - start) / ((double)n * rounds);         \
+    return true;                                                        \
+  }                                                                     \
+                                                                        \
+  static bool modify_##name(T *hs, long n, long rounds, result *res)    \
+  {                                                                     \
+    for (long i = 0; i < n; i++) {                                      \
+      hs[i] = create(Val_long(i));                                      \
+      if (hs[i] == NULL) return false;                                  \
+    }                                                                   \
+    double start = now_ns();                                            \
+    for (long r = 0; r < rounds; r++) {                                 \
+      value v = (r & 1) ? old_block : young_block(r);                   \
+      for (long i = 0; i < n; i++) modify(&hs[i], v);                   \
+    }                                                                   \
+    res->ns_per_op = (now_ns() - start) / ((double)n * rounds);         \
+    for (long i = 0; i < n; i++) delete(hs[i]);                         \
+    return true;                                                        \
+  }                                                                     \
+                                                                        \
+  static bool live_##name(T *hs, long n, long rounds, result *res)      \
+  {                                                                     \
+    double start = now_ns();                                            \
+    for (long i = 0; i < n; i++) {                                      \
+      hs[i] = create(old_block);                                        \
+      if (hs[i] == NULL) return false;                                  \
+    }                                                                   \
+    double mid = now_ns();                                              \
+    res->ns_per_op = (mid - start) / (double)n;                         \
+    for (long r = 0; r < rounds; r++) caml_gc_minor(Val_unit);          \
+    double end_minor = now_ns();                                        \
+    for (long r = 0; r < rounds; r++) caml_gc_major(Val_unit);          \
+    res->minor_ns = (end_minor - mid) / (double)rounds;                 \
+    res->major_ns = (now_ns() - end_minor) / (double)rounds;            \
+    for (long i = 0; i < n; i++) delete(hs[i]);                         \
+    return true;                                                        \
+  }                                                                     \
+                                                                        \
+  static bool mix_##name(T *hs, long n, long rounds, result *res)       \
+  {                                                                     \
+    for (long i = 0; i < n; i++) {                                      \
+      hs[i] = create(young_block(i));                                   \
+      if (hs[i] == NULL) return false;                                  \
+    }                                                                   \
+    double start = now_ns();                                            \
+    for (long r = 0; r < rounds; r++) {                                 \
+      value v = young_block(r);                                         \
+      long i = r % n;                                                   \
+      delete(hs[i]);                                                    \
+      hs[i] = create(v);                                                \
+      if (hs[i] == NULL) return false;                                  \
+    }                                                                   \
+    res->ns_per_op = (now_ns() - start) / (double)rounds;               \
+    for (long i = 0; i < n; i++) delete(hs[i]);                         \
+    return true;                                                        \
+  }
+
+DEFINE_WORKLOADS(boxroot, boxroot, boxroot_create, boxroot_delete,
+                 boxroot_modify)
+DEFINE_WORKLOADS(dll, dll_boxroot, dll_boxroot_create, dll_boxroot_delete,
+                 dll_boxroot_modify)
+DEFINE_WORKLOADS(bitmap, bitmap_boxroot, bitmap_boxroot_create,
+                 bitmap_boxroot_delete, bitmap_boxroot_modify)
+DEFINE_WORKLOADS(rem, rem_boxroot, rem_boxroot_create, rem_boxroot_delete,
+                 rem_boxroot_modify)
+DEFINE_WORKLOADS(arena, local_ref, alloc_local_ref, delete_local_ref,
+                 arena_modify)
+
+typedef bool (*workload)(void *hs, long n, long rounds, result *res);
+
+#define WORKLOADS(name)                                 \
+  { (workload)churn_##name, (workload)modify_##name,    \
+    (workload)live_##name, (workload)mix_##name }
+
+/* The arena is scanned by OCaml with the local roots */
+static void arena_get_scan_counters(struct boxroot_scan_counters *c)
+{
+  *c = (struct boxroot_scan_counters){ 0 };
+}
+
+typedef struct {
+  workload workloads[4]; /* In the order of [Backends.workload] */
+  void (*get_scan_counters)(struct boxroot_scan_counters *c);
+} backend;
+
+/* In the order of [Backends.backend] */
+static const backend backends[] = {
+  { WORKLOADS(boxroot), boxroot_get_scan_counters },
+  { WORKLOADS(dll), dll_boxroot_get_scan_counters },
+  { WORKLOADS(bitmap), bitmap_boxroot_get_scan_counters },
+  { WORKLOADS(rem), rem_boxroot_get_scan_counters },
+  { WORKLOADS(arena), arena_get_scan_counters },
+};
+
+#define ARENA 4
+
+static bool setup_done = false;
+
+static double average(long long total, long long count)
+{
+  return count == 0 ? 0. : (double)total / (double)count;
+}
+
+/* Run workload [w] with size [n] for [rounds] rounds on backend [b],
+   with [old] as old block. Returns the array of:
+   - the time per operation in ns,
+   - the wall time per forced minor and major collection in ns (live
+     only),
+   - the number of minor and major collections,
+   - the scanning time per minor and per major collection in ns,
+   - the scanning work per minor and per major collection,
+   as counted by the implementation. */
+value bench_backend_run(value b, value w, value n, value rounds, value old)
+{
+  if (!setup_done) {
+    dll_boxroot_setup();
+    bitmap_boxroot_setup();
+    rem_boxroot_setup();
+    caml_register_generational_global_root(&old_block);
+    setup_done = true;
+  }
+  caml_modify_generational_global_root(&old_block, old);
+  const backend *be = &backends[Long_val(b)];
+  void **hs = malloc(Long_val(n) * sizeof(void *));
+  if (hs == NULL) caml_raise_out_of_memory();
+  struct boxroot_scan_counters before, after;
+  result res = { 0., 0., 0. };
+  be->get_scan_counters(&before);
+  arena a;
+  if (Long_val(b) == ARENA) init_arena(&a);
+  bool ok = be->workloads[Long_val(w)](hs, Long_val(n), Long_val(rounds),
+                                       &res);
+  if (Long_val(b) == ARENA) drop_arena(&a);
+  be->get_scan_counters(&after);
+  free(hs);
+  if (!ok) caml_failwith("root creation failed");
+  long long minors = after.minor_collections - before.minor_collections;
+  long long majors = after.major_collections - before.major_collections;
+  double fields[] = {
+    res.ns_per_op, res.minor_ns, res.major_ns,
+    (double)minors, (double)majors,
+    average(after.minor_time - before.minor_time, minors),
+    average(after.major_time - before.major_time, majors),
+    average(after.scanning_work_minor - before.scanning_work_minor, minors),
+    average(after.scanning_work_major - before.scanning_work_major, majors),
+  };
+  size_t len = sizeof(fields) / sizeof(fields[0]);
+  value arr = caml_alloc_float_array(len);
+  for (size_t i = 0; i < len; i++) Store_double_flat_field(arr, i, fields[i]);
+  return arr;
+}
@@ -0,0 +1,34 @@
+(* Compare the per-root cost of [boxroot_create_n] and
+   [boxroot_delete_n] against loops of [boxroot_create] and
+   [boxroot_delete] for bulk rooting. *)
+
+external loop : int ref array -> int -> float * float = "bench_create_loop"
+external batch : int ref array -> int -> float * float = "bench_create_n"
+
+let total_roots = 20_000_000
+
+let () =
+  Printf.printf
+    "%10s %12s %12s %12s %12s\n"
+    "roots"
+    "create"
+    "create_n"
+    "delete"
+    "delete_n";
+  List.iter
+    (fun n ->
+      let arr = Array.init n (fun i -> ref i) in
+      let rounds = max 1 (total_roots / n) in
+      (* warm up the pools *)
+      ignore (loop arr 1 : float * float);
+      let create, delete = loop arr rounds in
+      let create_n, delete_n = batch arr rounds in
+      Printf.printf
+        "%10d %10.2fns %10.2fns %10.2fns %10.2fns\n"
+        n
+        create
+        create_n
+        delete
+        delete_n)
+    [ 16; 256; 4_096; 65_536; 1_048_576 ]
+;;
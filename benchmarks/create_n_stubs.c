@@ -0,0 +1,78 @@
+/* SPDX-License-Identifier: MIT */
+#define CAML_NAME_SPACE
+
+#include <stdlib.h>
+#include <time.h>
+
+#include <caml/mlvalues.h>
+#include <caml/alloc.h>
+#include <caml/fail.h>
+#include <caml/memory.h>
+#include "../boxroot/boxroot.h"
+
+static double now_ns(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)t.tv_sec * 1e9 + (double)t.tv_nsec;
+}
+
+static value pair_of_doubles(double a, double b)
+{
+  CAMLparam0();
+  CAMLlocal3(res, va, vb);
+  va = caml_copy_double(a);
+  vb = caml_copy_double(b);
+  res = caml_alloc_tuple(2);
+  Store_field(res, 0, va);
+  Store_field(res, 1, vb);
+  CAMLreturn(res);
+}
+
+/* Root every element of [arr], then release the roots, [rounds]
+   times. Returns the pair of the average times spent per root on
+   creation and on deletion, in nanoseconds. No OCaml allocation takes
+   place while the values are copied out of [arr]. */
+static value run(value arr, value rounds, bool batch)
+{
+  size_t n = Wosize_val(arr);
+  long r = Long_val(rounds);
+  value *vs = malloc(n * sizeof(value));
+  boxroot *roots = malloc(n * sizeof(boxroot));
+  if (vs == NULL || roots == NULL) caml_raise_out_of_memory();
+  for (size_t i = 0; i < n; i++) vs[i] = Field(arr, i);
+  double total_create = 0., total_delete = 0.;
+  for (long k = 0; k < r; k++) {
+    double start = now_ns();
+    if (batch) {
+      if (!boxroot_create_n(vs, n, roots)) caml_failwith("boxroot_create_n");
+    } else {
+      for (size_t i = 0; i < n; i++) {
+        roots[i] = boxroot_create(vs[i]);
+        if (roots[i] == NULL) caml_failwith("boxroot_create");
+      }
+    }
+    double mid = now_ns();
+    if (batch) {
+      boxroot_delete_n(roots, n);
+    } else {
+      for (size_t i = 0; i < n; i++) boxroot_delete(roots[i]);
+    }
+    total_create += mid - start;
+    total_delete += now_ns() - mid;
+  }
+  free(vs);
+  free(roots);
+  double count = (double)n * (double)r;
+  return pair_of_doubles(total_create / count, total_delete / count);
+}
+
+value bench_create_loop(value arr, value rounds)
+{
+  return run(arr, rounds, false);
+}
+
+value bench_create_n(value arr, value rounds)
+{
+  return run(arr, rounds, true);
+}
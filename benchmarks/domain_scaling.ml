@@ -0,0 +1,32 @@
+(* Throughput of boxroot creation and deletion as the number of
+   domains grows, each domain working on its own boxroots.
+   Usage: domain_scaling.exe [operations per domain] [max domains] *)
+
+external create_delete : int ref -> int -> unit = "bench_create_delete"
+
+let arg i default =
+  if Array.length Sys.argv > i then int_of_string Sys.argv.(i) else default
+;;
+
+let run ~domains ~n =
+  let start = Unix.gettimeofday () in
+  List.init domains (fun _ -> Domain.spawn (fun () -> create_delete (ref 0) n))
+  |> List.iter Domain.join;
+  Unix.gettimeofday () -. start
+;;
+
+let () =
+  let n = arg 1 10_000_000 in
+  let max_domains = arg 2 64 in
+  let rec loop domains =
+    if domains <= max_domains
+    then (
+      let elapsed = run ~domains ~n in
+      Printf.printf
+        "domains: %2d, %.1f M create+delete/s\n%!"
+        domains
+        (float_of_int (domains * n) /. elapsed /. 1e6);
+      loop (2 * domains))
+  in
+  loop 1
+;;
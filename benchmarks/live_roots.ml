@@ -0,0 +1,32 @@
+(* Major-scan time and RSS with a large set of long-lived boxroots.
+   Usage: live_roots.exe [number of roots] [number of major GCs]
+
+   Compare pool allocators by rebuilding with ENABLE_BOXROOT_SLAB=0. *)
+
+external root_all : int ref array -> unit = "bench_root_all"
+external release_all : unit -> unit = "bench_release_all"
+external rss_kib : unit -> int = "bench_rss_kib"
+external print_stats : unit -> unit = "bench_print_stats"
+
+let () =
+  let n = if Array.length Sys.argv > 1 then int_of_string Sys.argv.(1) else 1_000_000 in
+  let majors = if Array.length Sys.argv > 2 then int_of_string Sys.argv.(2) else 10 in
+  let rss_before = rss_kib () in
+  let arr = Array.init n (fun i -> ref i) in
+  root_all arr;
+  let rss_rooted = rss_kib () in
+  let start = Unix.gettimeofday () in
+  for _ = 1 to majors do
+    Gc.full_major ()
+  done;
+  let elapsed = Unix.gettimeofday () -. start in
+  Printf.printf
+    "roots: %d\nRSS before: %d KiB\nRSS with roots: %d KiB\ntime per full major: %.3f ms\n"
+    n
+    rss_before
+    rss_rooted
+    (elapsed *. 1000. /. float_of_int majors);
+  print_stats ();
+  release_all ();
+  ignore (Sys.opaque_identity arr : int ref array)
+;;
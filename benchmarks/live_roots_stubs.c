@@ -0,0 +1,112 @@
+/* SPDX-License-Identifier: MIT */
+#define CAML_NAME_SPACE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <caml/mlvalues.h>
+#include <caml/fail.h>
+#include "../boxroot/boxroot.h"
+
+static boxroot *live = NULL;
+static size_t live_count = 0;
+
+/* Keep a boxroot on every element of [arr] until [bench_release_all]. */
+value bench_root_all(value arr)
+{
+  size_t n = Wosize_val(arr);
+  live = realloc(live, (live_count + n) * sizeof(boxroot));
+  if (live == NULL) caml_raise_out_of_memory();
+  if (!boxroot_create_n(&Field(arr, 0), n, live + live_count))
+    caml_failwith("boxroot_create_n");
+  live_count += n;
+  return Val_unit;
+}
+
+value bench_release_all(value unit)
+{
+  boxroot_delete_n(live, live_count);
+  live_count = 0;
+  return Val_unit;
+}
+
+/* Release all the boxroots but one in [keep], leaving the
+   pools sparsely populated. */
+value bench_release_sparse(value keep)
+{
+  size_t k = Long_val(keep), kept = 0;
+  if (k == 0) caml_invalid_argument("bench_release_sparse");
+  for (size_t i = 0; i < live_count; i++) {
+    if (i % k == 0) live[kept++] = live[i];
+    else boxroot_delete(live[i]);
+  }
+  live_count = kept;
+  return Val_unit;
+}
+
+/* Leave about [npools] pools holding one boxroot to [v] each. The
+   other boxroots are deleted in random order, which shuffles the
+   order of the pools in their ring with respect to their addresses. */
+value bench_sparse_pools(value npools, value v)
+{
+  size_t n = Long_val(npools) * (BXR_POOL_SIZE / sizeof(boxroot));
+  boxroot *rs = malloc(n * sizeof(boxroot));
+  /* Pools hold more than half of BXR_POOL_SIZE / sizeof(boxroot)
+     roots */
+  live = realloc(live, (live_count + 2 * Long_val(npools) + 1)
+                       * sizeof(boxroot));
+  if (rs == NULL || live == NULL) caml_raise_out_of_memory();
+  uintptr_t last_pool = 0;
+  for (size_t i = 0; i < n; i++) {
+    rs[i] = boxroot_create(v);
+    if (rs[i] == NULL) caml_failwith("boxroot_create");
+    uintptr_t pool = (uintptr_t)rs[i] & ~(uintptr_t)(BXR_POOL_SIZE - 1);
+    if (pool != last_pool) {
+      /* Keep the first root of each pool */
+      live[live_count++] = rs[i];
+      rs[i] = NULL;
+      last_pool = pool;
+    }
+  }
+  srand(42);
+  for (size_t i = n - 1; i > 0; i--) {
+    size_t j = (size_t)rand() % (i + 1);
+    boxroot r = rs[i];
+    rs[i] = rs[j];
+    rs[j] = r;
+  }
+  for (size_t i = 0; i < n; i++) {
+    if (rs[i] != NULL) boxroot_delete(rs[i]);
+  }
+  free(rs);
+  return Val_unit;
+}
+
+value bench_set_scan_helpers(value n)
+{
+  if (!boxroot_set_scan_helpers(Int_val(n)))
+    caml_failwith("boxroot_set_scan_helpers");
+  return Val_unit;
+}
+
+/* Resident set size in KiB, or -1 if unknown. */
+value bench_rss_kib(value unit)
+{
+  long long rss = -1;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (f != NULL) {
+    long long size, resident;
+    if (fscanf(f, "%lld %lld", &size, &resident) == 2)
+      rss = resident * (sysconf(_SC_PAGESIZE) / 1024);
+    fclose(f);
+  }
+  return Val_long(rss);
+}
+
+value bench_print_stats(value unit)
+{
+  boxroot_print_stats();
+  fflush(stdout);
+  return Val_unit;
+}
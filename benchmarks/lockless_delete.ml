@@ -0,0 +1,48 @@
+(* Contention of deletions from threads holding no domain lock, with
+   each other and with the GC scanning the pools.
+   Usage: lockless_delete.exe [max threads] [roots per thread]
+
+   Foreign threads delete roots created beforehand, with and without
+   minor collections being forced meanwhile. The benchmark only uses
+   the public API of boxroot: to compare with an older version, copy
+   this file and its stubs into that tree. *)
+
+external lockless_delete : int ref -> int -> int -> bool -> float array
+  = "bench_lockless_delete"
+
+let arg i default =
+  if Array.length Sys.argv > i then int_of_string Sys.argv.(i) else default
+;;
+
+let () =
+  let max_threads = arg 1 8 in
+  let n = arg 2 1_000_000 in
+  let v = ref 0 in
+  Printf.printf
+    "%8s %5s %14s %8s %16s %16s\n"
+    "threads"
+    "GC"
+    "Mdeletes/s"
+    "minors"
+    "avg minor (us)"
+    "max minor (us)";
+  let rec loop threads =
+    if threads <= max_threads
+    then (
+      List.iter
+        (fun gc ->
+          Gc.full_major ();
+          let r = lockless_delete v threads n gc in
+          Printf.printf
+            "%8d %5b %14.2f %8.0f %16.1f %16.1f\n%!"
+            threads
+            gc
+            r.(0)
+            r.(1)
+            (r.(2) /. 1e3)
+            (r.(3) /. 1e3))
+        [ false; true ];
+      loop (2 * threads))
+  in
+  loop 1
+;;
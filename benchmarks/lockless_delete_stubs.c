@@ -0,0 +1,117 @@
+/* SPDX-License-Identifier: MIT */
+#define CAML_NAME_SPACE
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <caml/mlvalues.h>
+#include <caml/alloc.h>
+#include <caml/fail.h>
+#include <caml/signals.h>
+#include "../boxroot/boxroot.h"
+
+/* Only the public API of boxroot is used, so that this benchmark can
+   be run against older versions. */
+
+/* Gc.minor */
+CAMLextern value caml_gc_minor(value);
+
+static double now_ns(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)t.tv_sec * 1e9 + (double)t.tv_nsec;
+}
+
+typedef struct {
+  pthread_t thread;
+  boxroot *roots;
+  long count;
+} deleter;
+
+static atomic_bool go = false;
+static atomic_int running = 0;
+
+/* A foreign thread, holding no domain lock: deletes its roots once
+   started. */
+static void * delete_roots(void *arg)
+{
+  deleter *d = arg;
+  while (!atomic_load(&go)) ;
+  for (long i = 0; i < d->count; i++) boxroot_delete(d->roots[i]);
+  atomic_fetch_sub(&running, 1);
+  return NULL;
+}
+
+/* Create [n] boxroots to [v] for each of [threads] foreign threads,
+   which then delete them concurrently without holding any domain
+   lock. Consecutive roots go to different threads, so that the
+   threads deallocate in the same pools. If [gc], force minor
+   collections until the threads are done, so that deletions contend
+   with scanning.
+
+   Returns the array of:
+   - the deletion throughput in millions of deletions per second,
+   - the number of forced minor collections,
+   - their average and maximal duration in ns. */
+value bench_lockless_delete(value v, value threads, value n, value gc)
+{
+  int t = Int_val(threads);
+  long per_thread = Long_val(n);
+  deleter *ds = calloc(t, sizeof(deleter));
+  boxroot *roots = malloc(t * per_thread * sizeof(boxroot));
+  if (ds == NULL || roots == NULL) {
+    free(ds);
+    free(roots);
+    caml_raise_out_of_memory();
+  }
+  for (long i = 0; i < t * per_thread; i++) {
+    boxroot r = boxroot_create(v);
+    if (r == NULL) caml_failwith("boxroot_create");
+    roots[(i % t) * per_thread + i / t] = r;
+  }
+  atomic_store(&go, false);
+  atomic_store(&running, t);
+  for (int i = 0; i < t; i++) {
+    ds[i].roots = roots + i * per_thread;
+    ds[i].count = per_thread;
+    if (pthread_create(&ds[i].thread, NULL, delete_roots, &ds[i]) != 0) {
+      /* Let the threads already created finish, leak the rest */
+      atomic_store(&go, true);
+      for (int j = 0; j < i; j++) pthread_join(ds[j].thread, NULL);
+      free(roots);
+      free(ds);
+      caml_failwith("pthread_create");
+    }
+  }
+  long minors = 0;
+  double total_minor = 0., max_minor = 0.;
+  double start = now_ns();
+  atomic_store(&go, true);
+  while (Bool_val(gc) && atomic_load(&running) != 0) {
+    double before = now_ns();
+    caml_gc_minor(Val_unit);
+    double d = now_ns() - before;
+    minors++;
+    total_minor += d;
+    if (d > max_minor) max_minor = d;
+  }
+  caml_enter_blocking_section();
+  for (int i = 0; i < t; i++) pthread_join(ds[i].thread, NULL);
+  caml_leave_blocking_section();
+  double elapsed = now_ns() - start;
+  free(roots);
+  free(ds);
+  double fields[] = {
+    (double)(t * per_thread) / elapsed * 1e3,
+    (double)minors,
+    minors == 0 ? 0. : total_minor / (double)minors,
+    max_minor,
+  };
+  size_t len = sizeof(fields) / sizeof(fields[0]);
+  value arr = caml_alloc_float_array(len);
+  for (size_t i = 0; i < len; i++) Store_double_flat_field(arr, i, fields[i]);
+  return arr;
+}
@@ -0,0 +1,46 @@
+(* Distribution of pauses in an allocating loop with many long-lived
+   boxroots, to compare the major root scanning pause with and without
+   helper threads.
+   Usage: major_pause.exe [number of roots] [iterations] [helpers] *)
+
+external root_all : int ref array -> unit = "bench_root_all"
+external release_all : unit -> unit = "bench_release_all"
+external set_scan_helpers : int -> unit = "bench_set_scan_helpers"
+external print_stats : unit -> unit = "bench_print_stats"
+
+let arg i default =
+  if Array.length Sys.argv > i then int_of_string Sys.argv.(i) else default
+;;
+
+let percentile sorted p =
+  let n = Array.length sorted in
+  sorted.(min (n - 1) (int_of_float (p *. float_of_int n)))
+;;
+
+let () =
+  let n = arg 1 20_000_000 in
+  let iterations = arg 2 1_000_000 in
+  set_scan_helpers (arg 3 0);
+  let arr = Array.init n (fun i -> ref i) in
+  root_all arr;
+  let pauses = Array.make iterations 0. in
+  let sink = ref [] in
+  for i = 0 to iterations - 1 do
+    let start = Unix.gettimeofday () in
+    (* Some short-lived and some long-lived allocations *)
+    sink := Array.make 16 i :: (if i land 1023 = 0 then [] else !sink);
+    pauses.(i) <- Unix.gettimeofday () -. start
+  done;
+  Array.sort compare pauses;
+  let ms p = 1000. *. percentile pauses p in
+  Printf.printf
+    "roots: %d\np50: %.3f ms\np99: %.3f ms\np99.99: %.3f ms\nmax: %.3f ms\n"
+    n
+    (ms 0.5)
+    (ms 0.99)
+    (ms 0.9999)
+    (1000. *. pauses.(iterations - 1));
+  print_stats ();
+  release_all ();
+  ignore (Sys.opaque_identity arr : int ref array)
+;;
@@ -0,0 +1,51 @@
+(* Major scanning time on dense and sparse pools.
+   Usage: major_scan.exe [roots] [majors]
+
+   Compare kernels by rebuilding with ENABLE_BOXROOT_SIMD=0. *)
+
+external root_all : int ref array -> unit = "bench_root_all"
+external release_all : unit -> unit = "bench_release_all"
+external release_sparse : int -> unit = "bench_release_sparse"
+external print_stats : unit -> unit = "bench_print_stats"
+
+let arg i default =
+  if Array.length Sys.argv > i then int_of_string Sys.argv.(i) else default
+;;
+
+(* Time per full major with [n] roots of which one in [keep] is kept,
+   and a proportion [immediates] of immediate values. *)
+let run ~n ~majors ~keep ~immediates =
+  let arr =
+    Array.init n (fun i ->
+      if Random.float 1. < immediates then Obj.magic i else ref i)
+  in
+  root_all arr;
+  release_sparse keep;
+  Gc.full_major ();
+  let start = Unix.gettimeofday () in
+  for _ = 1 to majors do
+    Gc.full_major ()
+  done;
+  let elapsed = Unix.gettimeofday () -. start in
+  release_all ();
+  ignore (Sys.opaque_identity arr : int ref array);
+  elapsed *. 1000. /. float_of_int majors
+;;
+
+let () =
+  let n = arg 1 1_000_000 in
+  let majors = arg 2 10 in
+  Random.init 42;
+  List.iter
+    (fun (name, keep, immediates) ->
+      Printf.printf
+        "%s: %.3f ms per full major\n%!"
+        name
+        (run ~n ~majors ~keep ~immediates))
+    [ "dense", 1, 0.
+    ; "dense, 50% immediates", 1, 0.5
+    ; "sparse (1 in 16)", 16, 0.
+    ; "sparse (1 in 256)", 256, 0.
+    ];
+  print_stats ()
+;;
@@ -0,0 +1,32 @@
+(* Minor scanning work when few boxroots are allocated between two
+   minor collections. Each iteration roots [live] values for a while
+   and [fresh] values until the next minor collection.
+   Usage: minor_scan.exe [fresh per minor] [minors] [live]
+
+   Compare "work per minor" and "slots skipped per minor" in the
+   statistics. *)
+
+external root_all : int ref array -> unit = "bench_root_all"
+external release_all : unit -> unit = "bench_release_all"
+external print_stats : unit -> unit = "bench_print_stats"
+
+let arg i default =
+  if Array.length Sys.argv > i then int_of_string Sys.argv.(i) else default
+;;
+
+let () =
+  let fresh = arg 1 10 in
+  let minors = arg 2 10_000 in
+  let live = arg 3 1_000 in
+  let long_lived = Array.init live (fun i -> ref i) in
+  for i = 1 to minors do
+    if i mod 100 = 1
+    then (
+      release_all ();
+      root_all long_lived);
+    root_all (Array.init fresh (fun i -> ref i));
+    Gc.minor ()
+  done;
+  release_all ();
+  print_stats ()
+;;
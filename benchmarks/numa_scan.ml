@@ -0,0 +1,59 @@
+(* Root scanning time with domains pinned to NUMA nodes, each rooting
+   many values.
+   Usage: numa_scan.exe [domains] [roots per domain] [number of major GCs]
+
+   Compare with NUMA awareness disabled by rebuilding with
+   ENABLE_BOXROOT_NUMA=0. *)
+
+external root_all : int ref array -> unit = "bench_root_all"
+external release_all : unit -> unit = "bench_release_all"
+external numa_nodes : unit -> int = "bench_numa_nodes"
+external pin_to_node : int -> unit = "bench_pin_to_node"
+external print_stats : unit -> unit = "bench_print_stats"
+
+let arg i default =
+  if Array.length Sys.argv > i then int_of_string Sys.argv.(i) else default
+;;
+
+let () =
+  let nodes = numa_nodes () in
+  let domains = arg 1 (2 * nodes) in
+  let n = arg 2 1_000_000 in
+  let majors = arg 3 10 in
+  let ready = Atomic.make 0 in
+  let stop = Atomic.make false in
+  (* The roots of all domains are kept in the same table by the
+     stubs; each domain only roots its own values. *)
+  let lock = Mutex.create () in
+  let workers =
+    List.init domains (fun i ->
+      Domain.spawn (fun () ->
+        pin_to_node (i mod nodes);
+        let arr = Array.init n (fun i -> ref i) in
+        Mutex.protect lock (fun () -> root_all arr);
+        Atomic.incr ready;
+        while not (Atomic.get stop) do
+          Domain.cpu_relax ()
+        done;
+        ignore (Sys.opaque_identity arr : int ref array)))
+  in
+  while Atomic.get ready < domains do
+    Domain.cpu_relax ()
+  done;
+  Gc.full_major ();
+  let start = Unix.gettimeofday () in
+  for _ = 1 to majors do
+    Gc.full_major ()
+  done;
+  let elapsed = Unix.gettimeofday () -. start in
+  Atomic.set stop true;
+  List.iter Domain.join workers;
+  Printf.printf
+    "nodes: %d\ndomains: %d\nroots: %d\ntime per full major: %.3f ms\n"
+    nodes
+    domains
+    (domains * n)
+    (elapsed *. 1000. /. float_of_int majors);
+  print_stats ();
+  release_all ()
+;;
@@ -0,0 +1,56 @@
+/* SPDX-License-Identifier: MIT */
+#define CAML_NAME_SPACE
+#define _GNU_SOURCE
+
+#include <stdio.h>
+
+#include <caml/mlvalues.h>
+#include <caml/fail.h>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+/* Number of NUMA nodes, 1 if unknown. */
+value bench_numa_nodes(value unit)
+{
+  long n = 0;
+#if defined(__linux__)
+  char path[64];
+  for (;; n++) {
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%ld", n);
+    FILE *f = fopen(path, "r");
+    if (f == NULL) break;
+    fclose(f);
+  }
+#endif
+  return Val_long(n > 0 ? n : 1);
+}
+
+/* Restrict the current thread to the CPUs of NUMA node [node]. Does
+   nothing if they are unknown. */
+value bench_pin_to_node(value node)
+{
+#if defined(__linux__)
+  char path[64];
+  snprintf(path, sizeof(path),
+           "/sys/devices/system/node/node%ld/cpulist", Long_val(node));
+  FILE *f = fopen(path, "r");
+  if (f == NULL) return Val_unit;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  /* Format: ranges separated by commas, e.g. "0-7,16-23" */
+  int lo, hi;
+  while (fscanf(f, "%d", &lo) == 1) {
+    hi = lo;
+    if (fscanf(f, "-%d", &hi) != 1) hi = lo;
+    for (int cpu = lo; cpu <= hi && cpu < CPU_SETSIZE; cpu++)
+      CPU_SET(cpu, &set);
+    if (fgetc(f) != ',') break;
+  }
+  fclose(f);
+  if (sched_setaffinity(0, sizeof(set), &set) != 0)
+    caml_failwith("sched_setaffinity");
+#endif
+  return Val_unit;
+}
@@ -0,0 +1,33 @@
+(* Major scanning time with many sparsely-populated pools, linked in
+   shuffled address order.
+   Usage: pool_scan.exe [pools] [majors]
+
+   The default of 100,000 pools needs about 3 GiB at peak. *)
+
+external sparse_pools : int -> int ref -> unit = "bench_sparse_pools"
+external release_all : unit -> unit = "bench_release_all"
+external print_stats : unit -> unit = "bench_print_stats"
+
+let arg i default =
+  if Array.length Sys.argv > i then int_of_string Sys.argv.(i) else default
+;;
+
+let () =
+  let npools = arg 1 100_000 in
+  let majors = arg 2 10 in
+  let v = ref 0 in
+  sparse_pools npools v;
+  Gc.full_major ();
+  let start = Unix.gettimeofday () in
+  for _ = 1 to majors do
+    Gc.full_major ()
+  done;
+  let elapsed = Unix.gettimeofday () -. start in
+  Printf.printf
+    "pools: %d\ntime per full major: %.3f ms\n"
+    npools
+    (elapsed *. 1000. /. float_of_int majors);
+  print_stats ();
+  release_all ();
+  ignore (Sys.opaque_identity v : int ref)
+;;
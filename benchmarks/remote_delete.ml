@@ -0,0 +1,91 @@
+(* Throughput of remote deallocation: producer domains create
+   boxroots and pass them through a queue to consumer domains, which
+   delete them, first while holding their domain lock, then without
+   it. Pool counts are sampled while the benchmark runs, including
+   the sparsely-populated pools that remote deallocations can leave
+   behind (counted at major collections, at most 1/8 full). Live
+   pools are the pools holding roots or delayed deallocations, as
+   counted by boxroot.
+   Usage: remote_delete.exe [producers] [consumers] [roots per producer]
+            [batch] [sampling interval in s] *)
+
+external reset : int -> unit = "bench_queue_reset"
+external close : unit -> unit = "bench_queue_close"
+external produce : int -> int -> unit = "bench_produce"
+external consume : bool -> int -> int = "bench_consume"
+
+(* created, deleted, live pools, sparse pools *)
+external sample : unit -> int * int * int * int = "bench_sample"
+
+let arg i default =
+  if Array.length Sys.argv > i then int_of_string Sys.argv.(i) else default
+;;
+
+let run ~producers ~consumers ~n ~batch ~interval ~locked =
+  reset (64 * batch);
+  Gc.full_major ();
+  Printf.printf
+    "\nconsumers %s the domain lock\n%8s %12s %12s %12s %12s\n%!"
+    (if locked then "holding" else "without")
+    "time (s)"
+    "Mdeletes/s"
+    "in flight"
+    "live pools"
+    "sparse pools";
+  let start = Unix.gettimeofday () in
+  let ps = List.init producers (fun _ -> Domain.spawn (fun () -> produce n batch)) in
+  let cs =
+    List.init consumers (fun _ -> Domain.spawn (fun () -> consume locked batch))
+  in
+  let total = producers * n in
+  let rec loop last_time last_deleted =
+    Unix.sleepf interval;
+    let created, deleted, live_pools, sparse_pools = sample () in
+    let time = Unix.gettimeofday () in
+    Printf.printf
+      "%8.2f %12.2f %12d %12d %12d\n%!"
+      (time -. start)
+      (float_of_int (deleted - last_deleted) /. (time -. last_time) /. 1e6)
+      (created - deleted)
+      live_pools
+      sparse_pools;
+    if deleted < total then loop time deleted
+  in
+  loop start 0;
+  List.iter Domain.join ps;
+  close ();
+  let deleted = List.fold_left (fun acc d -> acc + Domain.join d) 0 cs in
+  let elapsed = Unix.gettimeofday () -. start in
+  (* The pools of the terminated producers are adopted at the first
+     scan, and emptied at the next one. *)
+  Gc.full_major ();
+  Gc.full_major ();
+  let _, _, live_pools, sparse_pools = sample () in
+  Printf.printf
+    "total: %.2f Mdeletes/s, after major GCs: %d live pools, %d sparse\n%!"
+    (float_of_int deleted /. elapsed /. 1e6)
+    live_pools
+    sparse_pools;
+  (* No root is left: every pool must have been emptied *)
+  if live_pools <> 0
+  then Printf.printf "warning: the count of live pools is inconsistent\n%!"
+;;
+
+let () =
+  let producers = arg 1 2 in
+  let consumers = arg 2 2 in
+  let n = arg 3 10_000_000 in
+  let batch = arg 4 64 in
+  let interval =
+    if Array.length Sys.argv > 5 then float_of_string Sys.argv.(5) else 0.5
+  in
+  Printf.printf
+    "producers: %d, consumers: %d, roots per producer: %d, batch: %d\n"
+    producers
+    consumers
+    n
+    batch;
+  List.iter
+    (fun locked -> run ~producers ~consumers ~n ~batch ~interval ~locked)
+    [ true; false ]
+;;
@@ -0,0 +1,160 @@
+/* SPDX-License-Identifier: MIT */
+#define CAML_NAME_SPACE
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include <caml/mlvalues.h>
+#include <caml/alloc.h>
+#include <caml/fail.h>
+#include <caml/signals.h>
+#include "../boxroot/boxroot.h"
+
+/* A bounded queue of boxroots, shared by the producers and the
+   consumers. Only accessed outside of the domain lock, since waiting
+   must not prevent collections. */
+static struct {
+  pthread_mutex_t mutex;
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
+  boxroot *items;
+  size_t capacity;
+  size_t head;
+  size_t len;
+  /* No more items will be pushed */
+  bool closed;
+} queue = {
+  .mutex = PTHREAD_MUTEX_INITIALIZER,
+  .not_empty = PTHREAD_COND_INITIALIZER,
+  .not_full = PTHREAD_COND_INITIALIZER,
+};
+
+static atomic_llong created = 0;
+static atomic_llong deleted = 0;
+
+/* Empty the queue and give it room for [capacity] boxroots. Call
+   while no producer or consumer runs. */
+value bench_queue_reset(value capacity)
+{
+  free(queue.items);
+  queue.capacity = Long_val(capacity);
+  queue.items = malloc(queue.capacity * sizeof(boxroot));
+  if (queue.items == NULL) caml_raise_out_of_memory();
+  queue.head = 0;
+  queue.len = 0;
+  queue.closed = false;
+  atomic_store(&created, 0);
+  atomic_store(&deleted, 0);
+  return Val_unit;
+}
+
+/* Let the consumers return once the queue is empty. */
+value bench_queue_close(value unit)
+{
+  pthread_mutex_lock(&queue.mutex);
+  queue.closed = true;
+  pthread_cond_broadcast(&queue.not_empty);
+  pthread_mutex_unlock(&queue.mutex);
+  return Val_unit;
+}
+
+/* Push [n] boxroots, waiting for room. */
+static void push(boxroot *rs, size_t n)
+{
+  pthread_mutex_lock(&queue.mutex);
+  for (size_t i = 0; i < n; i++) {
+    while (queue.len == queue.capacity) {
+      pthread_cond_broadcast(&queue.not_empty);
+      pthread_cond_wait(&queue.not_full, &queue.mutex);
+    }
+    queue.items[(queue.head + queue.len) % queue.capacity] = rs[i];
+    queue.len++;
+  }
+  pthread_cond_broadcast(&queue.not_empty);
+  pthread_mutex_unlock(&queue.mutex);
+}
+
+/* Pop up to [n] boxroots, waiting for some. Returns 0 only once the
+   queue is closed and empty. */
+static size_t pop(boxroot *rs, size_t n)
+{
+  pthread_mutex_lock(&queue.mutex);
+  while (queue.len == 0 && !queue.closed)
+    pthread_cond_wait(&queue.not_empty, &queue.mutex);
+  size_t k = queue.len < n ? queue.len : n;
+  for (size_t i = 0; i < k; i++) {
+    rs[i] = queue.items[queue.head];
+    queue.head = (queue.head + 1) % queue.capacity;
+  }
+  queue.len -= k;
+  if (k > 0) pthread_cond_broadcast(&queue.not_full);
+  pthread_mutex_unlock(&queue.mutex);
+  return k;
+}
+
+/* Create [n] boxroots to fresh young blocks in the current domain and
+   push them by batches of [batch]. */
+value bench_produce(value n, value batch)
+{
+  long total = Long_val(n), b = Long_val(batch);
+  boxroot *rs = malloc(b * sizeof(boxroot));
+  if (rs == NULL) caml_raise_out_of_memory();
+  for (long i = 0; i < total; i += b) {
+    long k = total - i < b ? total - i : b;
+    for (long j = 0; j < k; j++) {
+      value v = caml_alloc_small(1, 0);
+      Field(v, 0) = Val_long(j);
+      rs[j] = boxroot_create(v);
+      if (rs[j] == NULL) {
+        free(rs);
+        caml_failwith("boxroot_create");
+      }
+    }
+    atomic_fetch_add_explicit(&created, k, memory_order_relaxed);
+    caml_enter_blocking_section();
+    push(rs, k);
+    caml_leave_blocking_section();
+  }
+  free(rs);
+  return Val_unit;
+}
+
+/* Pop boxroots by batches of [batch] and delete them until the queue
+   is closed, holding the domain lock for deletion if [locked], and
+   without it otherwise. Returns the number of boxroots deleted. */
+value bench_consume(value locked, value batch)
+{
+  bool with_lock = Bool_val(locked);
+  size_t b = Long_val(batch);
+  boxroot *rs = malloc(b * sizeof(boxroot));
+  if (rs == NULL) caml_raise_out_of_memory();
+  long total = 0;
+  caml_enter_blocking_section();
+  size_t k;
+  while ((k = pop(rs, b)) != 0) {
+    if (with_lock) caml_leave_blocking_section();
+    for (size_t i = 0; i < k; i++) boxroot_delete(rs[i]);
+    if (with_lock) caml_enter_blocking_section();
+    atomic_fetch_add_explicit(&deleted, k, memory_order_relaxed);
+    total += k;
+  }
+  caml_leave_blocking_section();
+  free(rs);
+  return Val_long(total);
+}
+
+/* Returns the number of boxroots created and deleted so far, the
+   number of live pools, and the number of sparse pools (as of the
+   last major collection of each domain). */
+value bench_sample(value unit)
+{
+  struct boxroot_stats s;
+  boxroot_get_stats(&s);
+  value res = caml_alloc_tuple(4);
+  Store_field(res, 0, Val_long(atomic_load(&created)));
+  Store_field(res, 1, Val_long(atomic_load(&deleted)));
+  Store_field(res, 2, Val_long(s.live_pools));
+  Store_field(res, 3, Val_long(s.sparse_pools));
+  return res;
+}
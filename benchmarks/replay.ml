@@ -0,0 +1,65 @@
+(* Replay a trace of boxroot operations against each root
+   implementation, to compare them on a recorded workload.
+   Usage: replay.exe <trace> [rounds]
+
+   A trace is recorded by running a program using Boxroot compiled
+   with BOXROOT_TRACE=1 (both the library and the C code calling it),
+   with BOXROOT_TRACE_FILE=<trace> in the environment. The operations
+   of all threads are replayed in order on a single domain, with fresh
+   young blocks for young values and a single old block for old
+   values. Collections are forced where the trace has them. *)
+
+type backend =
+  | Boxroot
+  | Dll
+  | Bitmap
+  | Rem
+  | Arena
+
+external load : string -> int * int * int = "bench_replay_load"
+external run : backend -> int ref -> float array = "bench_replay_run"
+
+let name = function
+  | Boxroot -> "boxroot"
+  | Dll -> "dll_boxroot"
+  | Bitmap -> "bitmap_boxroot"
+  | Rem -> "rem_boxroot"
+  | Arena -> "arena"
+;;
+
+let () =
+  if Array.length Sys.argv < 2 then failwith "usage: replay.exe <trace> [rounds]";
+  let rounds = if Array.length Sys.argv > 2 then int_of_string Sys.argv.(2) else 3 in
+  let ops, peak, skipped = load Sys.argv.(1) in
+  Printf.printf "operations: %d\npeak live boxroots: %d\nskipped records: %d\n" ops peak skipped;
+  let old = ref 0 in
+  Gc.full_major ();
+  Printf.printf
+    "%15s %12s %12s %12s %14s %14s\n"
+    "implementation"
+    "Mops/s"
+    "total (ms)"
+    "GC (ms)"
+    "scanning (ms)"
+    "scanned slots";
+  List.iter
+    (fun b ->
+      (* Keep the best round *)
+      let best = ref [||] in
+      for _ = 1 to rounds do
+        let r = run b old in
+        if !best = [||] || r.(0) < !best.(0) then best := r
+      done;
+      let r = !best in
+      let mutator = r.(0) -. r.(1) in
+      Printf.printf
+        "%15s %12.2f %12.2f %12.2f %14s %14s\n"
+        (name b)
+        (float_of_int ops *. 1000. /. mutator)
+        (r.(0) /. 1e6)
+        (r.(1) /. 1e6)
+        (if b = Arena then "-" else Printf.sprintf "%.2f" (r.(2) /. 1e6))
+        (if b = Arena then "-" else Printf.sprintf "%.0f" r.(3)))
+    [ Boxroot; Dll; Bitmap; Rem; Arena ];
+  ignore (Sys.opaque_identity old : int ref)
+;;
@@ -0,0 +1,385 @@
+/* SPDX-License-Identifier: MIT */
+#define CAML_NAME_SPACE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <caml/mlvalues.h>
+#include <caml/alloc.h>
+#include <caml/fail.h>
+#include <caml/memory.h>
+#include "../boxroot/boxroot.h"
+#include "../boxroot/dll_boxroot.h"
+#include "../boxroot/bitmap_boxroot.h"
+#include "../boxroot/rem_boxroot.h"
+#include "../boxroot/arena.h"
+
+/* Gc.minor, Gc.major */
+CAMLextern value caml_gc_minor(value);
+CAMLextern value caml_gc_major(value);
+
+static double now_ns(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)t.tv_sec * 1e9 + (double)t.tv_nsec;
+}
+
+/* {{{ Loading */
+
+/* A trace is turned into a sequence of operations on numbered slots,
+   so that replaying it does not have to look up boxroot addresses.
+   The records of all threads are replayed in order on the current
+   domain. */
+
+typedef struct {
+  uint32_t slot;
+  uint8_t op; /* BOXROOT_TRACE_CREATE, _DELETE, _MODIFY, _*_SCAN */
+  uint8_t kind; /* BOXROOT_TRACE_IMMEDIATE, _YOUNG, _OLD */
+} replay_op;
+
+static replay_op *ops = NULL;
+static size_t ops_len = 0;
+/* Number of slots, that is the peak number of live boxroots */
+static uint32_t slots = 0;
+
+/* Boxroots by address, with open addressing. 0 marks an empty entry
+   and 1 a deleted one (addresses are aligned). */
+typedef struct {
+  uint64_t root;
+  uint32_t slot;
+} entry;
+
+static entry *table = NULL;
+static size_t table_size = 0, table_used = 0, table_live = 0;
+
+#define EMPTY 0
+#define DELETED 1
+
+static entry * lookup(uint64_t root)
+{
+  size_t mask = table_size - 1;
+  for (size_t i = (root >> 3) * 0x9E3779B97F4A7C15ULL & mask;;
+       i = (i + 1) & mask) {
+    if (table[i].root == root) return &table[i];
+    if (table[i].root == EMPTY) return NULL;
+  }
+}
+
+static void insert(uint64_t root, uint32_t slot);
+
+static void resize(size_t size)
+{
+  entry *old = table;
+  size_t old_size = table_size;
+  table = calloc(size, sizeof(entry));
+  if (table == NULL) caml_raise_out_of_memory();
+  table_size = size;
+  table_used = 0;
+  table_live = 0;
+  for (size_t i = 0; i < old_size; i++) {
+    if (old[i].root > DELETED) insert(old[i].root, old[i].slot);
+  }
+  free(old);
+}
+
+static void insert(uint64_t root, uint32_t slot)
+{
+  if (2 * (table_used + 1) > table_size) {
+    size_t size = 1024;
+    while (size < 4 * (table_live + 1)) size *= 2;
+    resize(size);
+  }
+  size_t mask = table_size - 1;
+  size_t i = (root >> 3) * 0x9E3779B97F4A7C15ULL & mask;
+  while (table[i].root > DELETED) i = (i + 1) & mask;
+  if (table[i].root == EMPTY) table_used++;
+  table_live++;
+  table[i].root = root;
+  table[i].slot = slot;
+}
+
+static void remove_entry(entry *e)
+{
+  e->root = DELETED;
+  table_live--;
+}
+
+static int compare_seq(const void *a, const void *b)
+{
+  uint64_t x = ((const struct boxroot_trace_record *)a)->seq;
+  uint64_t y = ((const struct boxroot_trace_record *)b)->seq;
+  return (x > y) - (x < y);
+}
+
+static void push_op(int op, uint32_t slot, int kind)
+{
+  ops[ops_len++] = (replay_op){ .slot = slot, .op = (uint8_t)op,
+                                .kind = (uint8_t)kind };
+}
+
+static struct boxroot_trace_record * read_trace(const char *path,
+                                                size_t *len)
+{
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) caml_failwith("cannot open the trace");
+  struct boxroot_trace_header h;
+  if (fread(&h, sizeof(h), 1, f) != 1
+      || h.magic != BOXROOT_TRACE_MAGIC
+      || h.version != BOXROOT_TRACE_VERSION
+      || h.record_size != sizeof(struct boxroot_trace_record)) {
+    fclose(f);
+    caml_failwith("not a trace, or of another version");
+  }
+  size_t cap = 1 << 16, n = 0;
+  struct boxroot_trace_record *rs = malloc(cap * sizeof(*rs));
+  while (rs != NULL) {
+    n += fread(rs + n, sizeof(*rs), cap - n, f);
+    if (n < cap) break;
+    cap *= 2;
+    struct boxroot_trace_record *bigger = realloc(rs, cap * sizeof(*rs));
+    if (bigger == NULL) free(rs);
+    rs = bigger;
+  }
+  fclose(f);
+  if (rs == NULL) caml_raise_out_of_memory();
+  *len = n;
+  return rs;
+}
+
+/* Load the trace at [path]. Returns the triple of the number of
+   operations, of the peak number of live boxroots, and of the
+   records ignored because they refer to boxroots created before the
+   trace started. */
+value bench_replay_load(value path)
+{
+  size_t len;
+  struct boxroot_trace_record *rs = read_trace(String_val(path), &len);
+  qsort(rs, len, sizeof(*rs), compare_seq);
+  free(ops);
+  ops = malloc((len + 1) * sizeof(replay_op));
+  uint32_t *free_slots = malloc((len + 1) * sizeof(uint32_t));
+  /* Last modified boxroot of each thread, for BOXROOT_TRACE_MOVE */
+  uint32_t threads = 1;
+  for (size_t i = 0; i < len; i++)
+    if (rs[i].thread >= threads) threads = rs[i].thread + 1;
+  uint64_t *last_modified = calloc(threads, sizeof(uint64_t));
+  if (ops == NULL || free_slots == NULL || last_modified == NULL)
+    caml_raise_out_of_memory();
+  ops_len = 0;
+  slots = 0;
+  size_t free_len = 0, skipped = 0;
+  resize(1024);
+  for (size_t i = 0; i < len; i++) {
+    struct boxroot_trace_record *r = &rs[i];
+    bool known = r->op == BOXROOT_TRACE_DELETE
+      || r->op == BOXROOT_TRACE_MODIFY;
+    entry *e = known ? lookup(r->root) : NULL;
+    switch (r->op) {
+    case BOXROOT_TRACE_CREATE: {
+      uint32_t slot = free_len > 0 ? free_slots[--free_len] : slots++;
+      insert(r->root, slot);
+      push_op(r->op, slot, r->flags);
+      break;
+    }
+    case BOXROOT_TRACE_DELETE:
+      if (e == NULL) { skipped++; break; }
+      push_op(r->op, e->slot, 0);
+      free_slots[free_len++] = e->slot;
+      remove_entry(e);
+      break;
+    case BOXROOT_TRACE_MODIFY:
+      last_modified[r->thread] = r->root;
+      if (e == NULL) { skipped++; break; }
+      push_op(r->op, e->slot, r->flags);
+      break;
+    case BOXROOT_TRACE_MOVE: {
+      uint64_t old = last_modified[r->thread];
+      entry *m = (old == 0) ? NULL : lookup(old);
+      last_modified[r->thread] = 0;
+      if (m == NULL) { skipped++; break; }
+      uint32_t slot = m->slot;
+      remove_entry(m);
+      insert(r->root, slot);
+      break;
+    }
+    case BOXROOT_TRACE_MINOR_SCAN:
+    case BOXROOT_TRACE_MAJOR_SCAN:
+      /* Each domain records the collections it takes part in */
+      if (ops_len > 0 && ops[ops_len - 1].op == r->op) break;
+      push_op(r->op, 0, 0);
+      break;
+    default:
+      skipped++;
+    }
+  }
+  free(rs);
+  free(free_slots);
+  free(last_modified);
+  free(table);
+  table = NULL;
+  table_size = 0;
+  value res = caml_alloc_tuple(3);
+  Store_field(res, 0, Val_long(ops_len));
+  Store_field(res, 1, Val_long(slots));
+  Store_field(res, 2, Val_long(skipped));
+  return res;
+}
+
+/* }}} */
+
+/* {{{ Replaying */
+
+/* Stands for the old values of the trace, registered by
+   [bench_replay_run]. */
+static value old_block = Val_unit;
+
+static inline value replay_value(int kind)
+{
+  switch (kind) {
+  case BOXROOT_TRACE_YOUNG: {
+    value v = caml_alloc_small(1, 0);
+    Field(v, 0) = Val_int(0);
+    return v;
+  }
+  case BOXROOT_TRACE_OLD: return old_block;
+  default: return Val_int(0);
+  }
+}
+
+static inline void arena_modify(local_ref *r, value v)
+{
+  *local_get_ref(*r) = v;
+}
+
+/* Replay the operations with one implementation, whose functions
+   are inlined. Collections are forced where the trace has them.
+   Stores the total time in [*total_ns], and the part spent in forced
+   collections in [*gc_ns]. Returns false if a creation failed. The
+   boxroots live at the end are deleted, untimed. */
+#define DEFINE_REPLAY(name, T, create, delete, modify)                 \
+  static bool replay_##name(double *total_ns, double *gc_ns)            \
+  {                                                                     \
+    T *handles = malloc((slots + 1) * sizeof(T));                       \
+    if (handles == NULL) return false;                                  \
+    bool ok = true;                                                     \
+    double gc = 0., start_all = now_ns();                               \
+    size_t i = 0;                                                       \
+    for (; i < ops_len; i++) {                                          \
+      replay_op o = ops[i];                                             \
+      switch (o.op) {                                                   \
+      case BOXROOT_TRACE_CREATE:                                        \
+        handles[o.slot] = create(replay_value(o.kind));                 \
+        ok = (handles[o.slot] != NULL);                                 \
+        break;                                                          \
+      case BOXROOT_TRACE_DELETE:                                        \
+        delete(handles[o.slot]);                                        \
+        break;                                                          \
+      case BOXROOT_TRACE_MODIFY:                                        \
+        modify(&handles[o.slot], replay_value(o.kind));                 \
+        break;                                                          \
+      default: {                                                        \
+        double start = now_ns();                                        \
+        if (o.op == BOXROOT_TRACE_MINOR_SCAN) caml_gc_minor(Val_unit);  \
+        else caml_gc_major(Val_unit);                                   \
+        gc += now_ns() - start;                                         \
+      }                                                                 \
+      }                                                                 \
+      if (!ok) break;                                                   \
+    }                                                                   \
+    *total_ns = now_ns() - start_all;                                   \
+    *gc_ns = gc;                                                        \
+    /* Delete what remains, including up to a failure */                \
+    bool *live = calloc(slots + 1, sizeof(bool));                       \
+    if (live == NULL) abort();                                          \
+    for (size_t j = 0; j < i; j++) {                                    \
+      if (ops[j].op == BOXROOT_TRACE_CREATE) live[ops[j].slot] = true;  \
+      if (ops[j].op == BOXROOT_TRACE_DELETE) live[ops[j].slot] = false; \
+    }                                                                   \
+    for (uint32_t s = 0; s < slots; s++) {                              \
+      if (live[s]) delete(handles[s]);                                  \
+    }                                                                   \
+    free(live);                                                         \
+    free(handles);                                                      \
+    return ok;                                                          \
+  }
+
+DEFINE_REPLAY(boxroot, boxroot, boxroot_create, boxroot_delete,
+              boxroot_modify)
+DEFINE_REPLAY(dll, dll_boxroot, dll_boxroot_create, dll_boxroot_delete,
+              dll_boxroot_modify)
+DEFINE_REPLAY(bitmap, bitmap_boxroot, bitmap_boxroot_create,
+              bitmap_boxroot_delete, bitmap_boxroot_modify)
+DEFINE_REPLAY(rem, rem_boxroot, rem_boxroot_create, rem_boxroot_delete,
+              rem_boxroot_modify)
+DEFINE_REPLAY(arena_ops, local_ref, alloc_local_ref, delete_local_ref,
+              arena_modify)
+
+static bool replay_arena(double *total_ns, double *gc_ns)
+{
+  arena a;
+  init_arena(&a);
+  bool ok = replay_arena_ops(total_ns, gc_ns);
+  drop_arena(&a);
+  return ok;
+}
+
+/* The arena is scanned by OCaml with the local roots */
+static void arena_get_scan_counters(struct boxroot_scan_counters *c)
+{
+  *c = (struct boxroot_scan_counters){ 0 };
+}
+
+typedef struct {
+  bool (*replay)(double *total_ns, double *gc_ns);
+  void (*get_scan_counters)(struct boxroot_scan_counters *c);
+} backend;
+
+/* In the order of [Replay.backend] */
+static const backend backends[] = {
+  { replay_boxroot, boxroot_get_scan_counters },
+  { replay_dll, dll_boxroot_get_scan_counters },
+  { replay_bitmap, bitmap_boxroot_get_scan_counters },
+  { replay_rem, rem_boxroot_get_scan_counters },
+  { replay_arena, arena_get_scan_counters },
+};
+
+static bool setup_done = false;
+
+/* Replay the loaded trace with implementation [b], using the old
+   block [old] for old values. Returns the array of the total time
+   and the time spent in forced collections in ns, of the time spent
+   scanning in ns and of the number of slots scanned as counted by
+   the implementation. */
+value bench_replay_run(value b, value old)
+{
+  if (!setup_done) {
+    dll_boxroot_setup();
+    bitmap_boxroot_setup();
+    rem_boxroot_setup();
+    caml_register_generational_global_root(&old_block);
+    setup_done = true;
+  }
+  caml_modify_generational_global_root(&old_block, old);
+  const backend *be = &backends[Long_val(b)];
+  struct boxroot_scan_counters before, after;
+  be->get_scan_counters(&before);
+  double elapsed, gc_ns;
+  bool ok = be->replay(&elapsed, &gc_ns);
+  be->get_scan_counters(&after);
+  if (!ok) caml_failwith("root creation failed");
+  value res = caml_alloc_float_array(4);
+  Store_double_flat_field(res, 0, elapsed);
+  Store_double_flat_field(res, 1, gc_ns);
+  Store_double_flat_field(res, 2,
+    (double)(after.minor_time + after.major_time
+             - before.minor_time - before.major_time));
+  Store_double_flat_field(res, 3,
+    (double)(after.scanning_work_minor + after.scanning_work_major
+             - before.scanning_work_minor - before.scanning_work_major));
+  return res;
+}
+
+/* }}} */
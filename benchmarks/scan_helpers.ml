@@ -0,0 +1,37 @@
+(* Scaling of major root scanning with the number of helper threads,
+   with all the boxroots in one domain.
+   Usage: scan_helpers.exe [number of roots] [number of major GCs] *)
+
+external root_all : int ref array -> unit = "bench_root_all"
+external release_all : unit -> unit = "bench_release_all"
+external set_scan_helpers : int -> unit = "bench_set_scan_helpers"
+external print_stats : unit -> unit = "bench_print_stats"
+
+let arg i default =
+  if Array.length Sys.argv > i then int_of_string Sys.argv.(i) else default
+;;
+
+let () =
+  let n = arg 1 10_000_000 in
+  let majors = arg 2 10 in
+  let arr = Array.init n (fun i -> ref i) in
+  root_all arr;
+  Gc.full_major ();
+  Printf.printf "roots: %d\n%!" n;
+  List.iter
+    (fun helpers ->
+      set_scan_helpers helpers;
+      let start = Unix.gettimeofday () in
+      for _ = 1 to majors do
+        Gc.full_major ()
+      done;
+      let elapsed = Unix.gettimeofday () -. start in
+      Printf.printf
+        "helpers: %d, time per full major: %.3f ms\n%!"
+        helpers
+        (elapsed *. 1000. /. float_of_int majors))
+    [ 0; 1; 2; 4; 8 ];
+  print_stats ();
+  release_all ();
+  ignore (Sys.opaque_identity arr : int ref array)
+;;
@@ -0,0 +1,41 @@
+(* First-allocation latency and RSS for workloads spawning many
+   short-lived domains, each rooting a few values.
+   Usage: short_domains.exe [domains per round] [rounds] [roots per domain]
+
+   Pools are allocated from huge-page backed slabs by default, whose
+   first touch faults in a whole 2MB page: the RSS then measures the
+   slab allocator rather than the lazy initialisation of pools. Run
+   with ENABLE_BOXROOT_SLAB=0 in the environment (a build-time flag,
+   see boxroot/dune) to measure the latter:
+     ENABLE_BOXROOT_SLAB=0 dune exec --release benchmarks/short_domains.exe *)
+
+external first_create : int ref -> int -> float = "bench_first_create"
+external rss_kib : unit -> int = "bench_rss_kib"
+external print_stats : unit -> unit = "bench_print_stats"
+
+let arg i default =
+  if Array.length Sys.argv > i then int_of_string Sys.argv.(i) else default
+;;
+
+let () =
+  let domains = arg 1 8 in
+  let rounds = arg 2 100 in
+  let roots = arg 3 10 in
+  let v = ref 0 in
+  let total = ref 0. in
+  let peak = ref 0. in
+  for _ = 1 to rounds do
+    List.init domains (fun _ -> Domain.spawn (fun () -> first_create v roots))
+    |> List.iter (fun d ->
+      let t = Domain.join d in
+      total := !total +. t;
+      if t > !peak then peak := t)
+  done;
+  Printf.printf
+    "domains: %d\naverage first allocation: %.0f ns\npeak first allocation: %.0f ns\nRSS: %d KiB\n"
+    (domains * rounds)
+    (!total /. float_of_int (domains * rounds))
+    !peak
+    (rss_kib ());
+  print_stats ()
+;;
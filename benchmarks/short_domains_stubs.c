@@ -0,0 +1,49 @@
+/* SPDX-License-Identifier: MIT */
+#define CAML_NAME_SPACE
+
+#include <time.h>
+
+#include <caml/mlvalues.h>
+#include <caml/alloc.h>
+#include <caml/fail.h>
+#include "../boxroot/boxroot.h"
+
+static double now_ns(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)t.tv_sec * 1e9 + (double)t.tv_nsec;
+}
+
+/* Time the first allocation of a boxroot in the current domain, which
+   includes setting up a pool, in nanoseconds. Then root [v] [n] more
+   times and release everything. */
+value bench_first_create(value v, value n)
+{
+  double start = now_ns();
+  boxroot r = boxroot_create(v);
+  double elapsed = now_ns() - start;
+  if (r == NULL) caml_failwith("boxroot_create");
+  for (long i = 0; i < Long_val(n); i++) {
+    boxroot s = boxroot_create(v);
+    if (s == NULL) caml_failwith("boxroot_create");
+    boxroot_delete(s);
+  }
+  boxroot_delete(r);
+  return caml_copy_double(elapsed);
+}
+
+/* Create and delete [n] boxroots to [v] in batches of 64 in the
+   current domain. */
+value bench_create_delete(value v, value n)
+{
+  boxroot rs[64];
+  for (long i = 0; i < Long_val(n); i += 64) {
+    for (int j = 0; j < 64; j++) {
+      rs[j] = boxroot_create(v);
+      if (rs[j] == NULL) caml_failwith("boxroot_create");
+    }
+    for (int j = 0; j < 64; j++) boxroot_delete(rs[j]);
+  }
+  return Val_unit;
+}
@@ -0,0 +1,46 @@
+(* Minor scanning time as a function of the proportion of young
+   values among the roots, as in the table above [scan_pool_young].
+   Usage: young_scan.exe [roots] [minors]
+
+   Compare kernels by rebuilding with ENABLE_BOXROOT_SIMD=0. *)
+
+external root_all : int ref array -> unit = "bench_root_all"
+external release_all : unit -> unit = "bench_release_all"
+external print_stats : unit -> unit = "bench_print_stats"
+
+let arg i default =
+  if Array.length Sys.argv > i then int_of_string Sys.argv.(i) else default
+;;
+
+(* Time spent in minor collections with [n] roots, of which a
+   proportion [hits] (randomly distributed) are young. *)
+let run ~n ~minors ~hits =
+  let old = Array.init n (fun i -> ref i) in
+  Gc.full_major ();
+  let elapsed = ref 0. in
+  for _ = 1 to minors do
+    let roots =
+      Array.init n (fun i -> if Random.float 1. < hits then ref i else old.(i))
+    in
+    root_all roots;
+    let start = Unix.gettimeofday () in
+    Gc.minor ();
+    elapsed := !elapsed +. (Unix.gettimeofday () -. start);
+    release_all ()
+  done;
+  !elapsed *. 1e6 /. float_of_int minors
+;;
+
+let () =
+  let n = arg 1 100_000 in
+  let minors = arg 2 100 in
+  Random.init 42;
+  List.iter
+    (fun hits ->
+      Printf.printf
+        "young hits=%2.0f%%: %.1f µs per minor\n%!"
+        (hits *. 100.)
+        (run ~n ~minors ~hits))
+    [ 0.; 0.1; 0.5; 0.95 ];
+  print_stats ()
+;;
@@ -502,6 +502,16 @@ static double average(long long total, long long units)
   return ((double)total) / (double)units;
 }
 
+void bitmap_boxroot_get_scan_counters(struct boxroot_scan_counters *c)
+{
+  c->minor_collections = stats.minor_collections;
+  c->major_collections = stats.major_collections;
+  c->scanning_work_minor = stats.total_scanning_work_minor;
+  c->scanning_work_major = stats.total_scanning_work_major;
+  c->minor_time = stats.total_minor_time;
+  c->major_time = stats.total_major_time;
+}
+
 void bitmap_boxroot_print_stats()
 {
   printf("minor collections: %d\n"
@@ -600,7 +610,7 @@ int bitmap_boxroot_setup()
   stats = empty_stats;
   rings.young = NULL;
   rings.old = NULL;
-  bxr_setup_hooks(&scanning_callback, NULL);
+  bxr_setup_hooks(&scanning_callback, NULL, NULL);
   // we are done
   setup = 1;
   if (BOXROOT_DEBUG) validate_all_rings();
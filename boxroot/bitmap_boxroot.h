@@ -3,6 +3,7 @@
 #define BITMAP_BOXROOT_H
 
 #include <caml/mlvalues.h>
+#include "boxroot_stats.h"
 
 typedef struct bitmap_boxroot_private* bitmap_boxroot;
 
@@ -52,4 +53,7 @@ void bitmap_boxroot_teardown();
 /* Show some statistics on the standard output. */
 void bitmap_boxroot_print_stats();
 
+/* Fill `c` with the scanning counters (see boxroot_stats.h). */
+void bitmap_boxroot_get_scan_counters(struct boxroot_scan_counters *c);
+
 #endif // BITMAP_BOXROOT_H
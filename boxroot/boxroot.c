@@ -10,6 +10,7 @@
 #include <stdalign.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -17,6 +18,8 @@
 #define CAML_INTERNALS
 
 #include "boxroot.h"
+#include <caml/fail.h>
+#include <caml/memory.h>
 #include <caml/minor_gc.h>
 #include <caml/major_gc.h>
 
@@ -28,6 +31,10 @@
 #include "ocaml_hooks.h"
 #include "platform.h"
 
+#if BXR_SIMD_AVX2
+#include <immintrin.h>
+#endif
+
 static_assert(!BXR_FORCE_REMOTE || BXR_MULTITHREAD,
               "invalid configuration");
 
@@ -60,12 +67,14 @@ typedef struct pool {
 
      In addition, the OCaml GC can access the cells concurrently. The
      OCaml GC assumes temporary ownership during stop-the-world
-     sections, and while holding the mutex below.
+     sections, once the lock-less deleters of the pool (see below)
+     are done.
 
      Consequently, access to the contents of `roots` is permitted for
      someone owning a cell either:
      - by holding _any_ domain lock, or
-     - by holding the mutex below.
+     - by being counted as a lock-less deleter of the pool while no
+       STW section accesses the pools.
 
      The ownership discipline ensures that there are no concurrent
      mutations of the same cell coming from the mutator.
@@ -73,10 +82,10 @@ typedef struct pool {
      To sum up, cells are protected by a combination of:
      - the user's ownership discipline,
      - the domain lock,
-     - the pool mutex.
+     - the lock-less deletion protocol (see `free_slots_lockless`).
 
      Given that in order to dereference and modify a boxroot one needs
-     a domain lock, the mutex is only needed by the mutator for the
+     a domain lock, the protocol is only needed by the mutator for the
      accesses during deallocations without holding any domain lock. */
 
   /* Free list, protected by domain lock. */
@@ -84,17 +93,38 @@ typedef struct pool {
   /* Owned by the pool ring. */
   struct pool *prev;
   struct pool *next;
-  /* Note: `mutex` and `delayed_fl` are placed on their own cache
-     line. Notably, together they exactly fit 8 words on Linux
-     64-bit and this only wastes two padding words. */
+  /* Slots are handed to the free list lazily (see `carve_slots`).
+     Slots at index `bump` and beyond have not been part of the free
+     list since the pool was last empty, and their contents are
+     unspecified. Thus `bump` is a high-water mark of the allocated
+     slots, which bounds young scanning. Protected by domain lock. */
+  int bump;
+  /* Position in the directory of the young or old ring holding the
+     pool (see `pool_dir`), -1 if none. Protected by domain lock. */
+  int dir_index;
+  /* NUMA node preferred for the memory of the pool, set when it is
+     allocated. */
+  int node;
+  /* Lifetime accounting (see `observe_deaths`): the minor and major
+     epochs of the domain when the pool last received new boxroots,
+     and its number of allocated slots when last observed. Protected
+     by domain lock. */
+  int birth_minor;
+  int birth_major;
+  int last_live;
+  /* Note: `delayed_fl` and `lockless_deleters` are placed on their
+     own cache line, which lock-less and remote deallocations touch
+     anyway. */
   /* Delayed free list. Pushing is protected holding either of:
-     - the pool mutex
-     - a domain lock.
-     Flushing is protected by holding both the pool mutex and all
-     domain locks (or knowing no other thread owns a slot). */
+     - a domain lock,
+     - a count in `lockless_deleters`.
+     Flushing is protected by holding all domain locks once the
+     lock-less deleters are done (or knowing no other thread owns a
+     slot). */
   alignas(Cache_line_size) atomic_free_list delayed_fl;
-  /* The pool mutex */
-  mutex_t mutex;
+  /* Number of deallocations in progress on this pool from threads
+     holding no domain lock. */
+  atomic_int lockless_deleters;
   /* Allocated slots hold OCaml values. Unallocated slots hold a
      pointer to the next slot in the free list, or to the pool itself,
      denoting the empty free list. */
@@ -103,6 +133,16 @@ typedef struct pool {
 
 #define POOL_CAPACITY ((int)((BXR_POOL_SIZE - sizeof(pool)) / sizeof(bxr_slot)))
 
+/* Fresh slots are handed to the free list in chunks that double in
+   size, starting from CARVE_MIN_SLOTS slots, so that `bump` stays
+   close to the number of slots in use, and that never cross a
+   CARVE_SIZE boundary (an OS page), so that pages are touched one at
+   a time. This only saves memory for pools from posix_memalign: the
+   first touch of a pool from a huge-page slab (see platform.c)
+   faults in the whole 2MB huge page. */
+#define CARVE_MIN_SLOTS 32
+#define CARVE_SIZE ((uintptr_t)4096)
+
 static_assert(BXR_POOL_SIZE / sizeof(bxr_slot) <= INT_MAX, "pool size too large");
 static_assert(POOL_CAPACITY >= 1, "pool size too small");
 static_assert(offsetof(pool, free_list) == 0, "incorrect free_list offset");
@@ -111,6 +151,18 @@ static_assert(offsetof(pool, free_list) == 0, "incorrect free_list offset");
 
 /* {{{ Globals */
 
+/* The pools of a scanned ring, in no particular order. Scanning
+   iterates over the directory rather than following the ring links,
+   so that the next pools can be prefetched. */
+typedef struct {
+  pool **pools;
+  int len;
+  int capacity;
+  /* Growing `pools` failed: the ring is scanned instead, and the
+     directory is no longer maintained. */
+  bool failed;
+} pool_dir;
+
 /* Global pool rings. */
 typedef struct {
   /* Pool of old values: contains only roots pointing to the major
@@ -128,60 +180,35 @@ typedef struct {
   /* Pools containing no root: not scanned.
      We could free these pools immediately, but this could lead to
      stuttering behavior for workloads that regularly come back to
-     0 boxroots alive. Instead we wait for the next major root
-     scanning to free empty pools. */
+     0 boxroots alive. Instead, at the next major root scanning, we
+     keep `free_target` of them and decommit the others (see
+     `trim_free_pools`). */
   pool *free;
+  /* Empty pools whose memory has been given back to the OS. They are
+     reused before allocating new pools, and freed if still unused at
+     the next major root scanning. Not scanned. */
+  pool *decommitted;
+  /* Number of empty pools kept committed at major root scanning. */
+  int free_target;
+  /* Number of empty pools needed since the last major root scanning
+     (taken from `free` or `decommitted`, or newly allocated). */
+  int free_demand;
+  /* Directories of the `old` and `young` rings. */
+  pool_dir old_dir;
+  pool_dir young_dir;
+  /* NUMA node of the domain, recorded at its first allocation (see
+     `register_domain_node`), -1 if not yet known. */
+  int node;
 } pool_rings;
 
-/* Only accessed from one's own domain. Ownership requires the domain
-   lock. */
-// TODO: Avoid false sharing?
-static pool_rings *pools[Num_domains] = { NULL };
-
-/* Holds the live pools of terminated domains until the next GC.
-   Owned by orphan_mutex. */
-static pool_rings orphan = { NULL, NULL, NULL, NULL };
-static mutex_t orphan_mutex = BXR_MUTEX_INITIALIZER;
-
-static bxr_free_list empty_fl = { (bxr_slot_ref)&empty_fl, NULL, -1, -1, UNTRACKED };
-
-/* We cache the domain id for:
-  - Fast detection of initialization (-1 if not initialized on this domain)
-  - Lookup of current domain id fast and in parallel with other tests
-*/
-_Thread_local ptrdiff_t bxr_cached_dom_id = -1;
-
-/* Only accessed from one's own domain. Ownership requires the domain
-   lock. */
-// TODO: Avoid false sharing?
-bxr_free_list *bxr_current_free_list[Num_domains + 1] =
-  { &empty_fl, /* domain -1, always empty (trap for initialization) */
-    &empty_fl, /* domain 0, accessed without initialization when
-                  BXR_MULTITHREAD == 0 */
-    /* NULL...*/ };
-
-/* ownership required: domain */
-static void set_current_fl(int dom_id, bxr_free_list *fl)
-{
-  DEBUGassert(dom_id >= 0 && dom_id < Num_domains);
-  bxr_current_free_list[dom_id + 1] = fl;
-}
-
-/* ownership required: domain */
-static void init_pool_rings(int dom_id)
-{
-  pool_rings *local = pools[dom_id];
-  if (local == NULL) local = malloc(sizeof(pool_rings));
-  if (local == NULL) return;
-  local->old = NULL;
-  local->young = NULL;
-  local->current = NULL;
-  local->free = NULL;
-  set_current_fl(dom_id, &empty_fl);
-  pools[dom_id] = local;
-}
+/* Bounds for `free_target`. Change this with benchmarks in hand. */
+#define FREE_POOLS_MIN 2
+#define FREE_POOLS_MAX 256
 
-static struct {
+/* Statistics, sharded by domain (see `DOMAIN_STATS`): each thread
+   counts in the shard of its domain, or in the shard of domain -1 if
+   it has none. Summed on demand by `boxroot_get_stats`. */
+typedef struct {
   atomic_llong minor_collections;
   atomic_llong major_collections;
   atomic_llong total_create_young;
@@ -193,8 +220,20 @@ static struct {
   atomic_llong total_modify;
   atomic_llong total_modify_slow;
   atomic_llong total_gc_pool_rings;
+  atomic_llong total_remote_flushes;
+  atomic_llong total_delete_lockless;
+  atomic_llong total_lockless_backoffs;
+  atomic_llong total_parallel_scans;
   atomic_llong total_scanning_work_minor;
   atomic_llong total_scanning_work_major;
+  atomic_llong young_slots_skipped; // beyond the high-water mark
+  atomic_llong young_hit_young; /* number of times a young value was encountered
+                             during young scanning (minor collection) */
+  atomic_llong young_hit_gen; /* number of times a young value was encountered
+                           during generic scanning (not minor collection) */
+  atomic_llong total_deaths; // deallocations observed by lifetime accounting
+  atomic_llong deaths_before_minor; // ...of which before any scan
+  /* in ticks of `bxr_clock_ticks` */
   atomic_llong total_minor_time;
   atomic_llong total_major_time;
   atomic_llong peak_minor_time;
@@ -202,27 +241,314 @@ static struct {
   atomic_llong total_alloced_pools;
   atomic_llong total_emptied_pools;
   atomic_llong total_freed_pools;
-  atomic_llong live_pools; // number of tracked pools
-  atomic_llong peak_pools; // max live pools at any time
+  atomic_llong total_decommitted_pools;
+  atomic_llong total_recommitted_pools;
+  /* The following two are differences: a shard can be negative when
+     pools move between domains, only the sum is meaningful. */
+  atomic_llong decommitted_pools; // number of pools currently decommitted
+  atomic_llong free_pools_target; // sum of the free_target of domains
+  /* Tracked pools at most 1/SPARSE_POOL_RATIO full, as of the last
+     major scan of the domain */
+  atomic_llong sparse_pools;
   atomic_llong ring_operations; // Number of times p->next is mutated
-  atomic_llong young_hit_gen; /* number of times a young value was encountered
-                           during generic scanning (not minor collection) */
-  atomic_llong young_hit_young; /* number of times a young value was encountered
-                             during young scanning (minor collection) */
   atomic_llong get_pool_header; // number of times get_pool_header was called
   atomic_llong is_pool_member; // number of times is_pool_member was called
+} domain_stats;
+
+/* The private contents of `bxr_domain_state`, see boxroot.h. Each
+   domain has its own cache lines, which it is the only one to
+   write. */
+typedef struct {
+  /* Must come first */
+  bxr_free_list *current_free_list;
+  long sample_countdown;
+  pool_rings rings;
+  domain_stats stats;
+  /* The sampling rate in effect for `sample_countdown` */
+  int sampling_rate;
+  uint32_t sampling_seed;
+  /* Number of minor and major scans of the domain */
+  int minor_epoch;
+  int major_epoch;
+  /* Allocations are counted on the countdown: `creations` plus
+     `countdown_mark - sample_countdown` is the number of boxroots
+     created since the last scan (see `set_countdown`). */
+  long countdown_mark;
+  long long creations;
+} domain_state;
+
+static_assert(sizeof(domain_state) <= sizeof(bxr_domain_state),
+              "BXR_DOMAIN_STATE_SIZE too small");
+static_assert(offsetof(domain_state, current_free_list)
+              == offsetof(bxr_domain_state, current_free_list),
+              "incorrect current_free_list offset");
+static_assert(offsetof(domain_state, sample_countdown)
+              == offsetof(bxr_domain_state, sample_countdown),
+              "incorrect sample_countdown offset");
+
+static bxr_free_list empty_fl = { (bxr_slot_ref)&empty_fl, NULL, -1, -1, UNTRACKED, 0 };
+
+/* Only accessed from one's own domain. Ownership requires the domain
+   lock. */
+bxr_domain_state bxr_domain_states[Num_domains + 1] =
+  { { .current_free_list = &empty_fl }, /* domain -1, always empty
+                                           (trap for initialization) */
+    { .current_free_list = &empty_fl }, /* domain 0, accessed without
+                                           initialization when
+                                           BXR_MULTITHREAD == 0 */
+    /* NULL...*/ };
+
+static inline domain_state * get_domain_state(int dom_id)
+{
+  return (domain_state *)&bxr_domain_states[dom_id + 1];
+}
+
+/* Rings of each domain, NULL if not initialised. Points inside
+   `bxr_domain_states`; written once by each domain. */
+static pool_rings *pools[Num_domains] = { NULL };
+
+/* Holds the live pools of terminated domains until the next GC, by
+   NUMA node of the pools. Owned by orphan_mutex. */
+static pool_rings orphan[BXR_MAX_NUMA_NODES];
+static mutex_t orphan_mutex = BXR_MUTEX_INITIALIZER;
+
+/* Number of live domains with pools on each NUMA node. Orphans of a
+   node are adopted by a domain of that node if there is one (see
+   `adopt_orphaned_pools`). */
+static atomic_int domains_on_node[BXR_MAX_NUMA_NODES];
+
+/* Number of domains currently accessing their pools inside a STW
+   section (or terminating). While non-zero, lock-less deleters wait. */
+static atomic_int scanning_domains = 0;
+
+/* Set once and for all by the first lock-less deallocation. Until
+   then, scanning domains do not need to look at the lock-less
+   deleters of each pool. */
+static atomic_bool lockless_deletion_seen = false;
+
+/* Number of threads flushing their remote buffers at the boundaries
+   of a scan (`try_flush_remote_bufs`). These use the lock-less
+   protocol without setting `lockless_deletion_seen`, so scanning
+   domains also look at the lock-less deleters while it is non-zero. */
+static atomic_int boundary_flushers = 0;
+
+/* We cache the domain id for:
+  - Fast detection of initialization (-1 if not initialized on this domain)
+  - Lookup of current domain id fast and in parallel with other tests
+*/
+_Thread_local ptrdiff_t bxr_cached_dom_id = -1;
+
+/* ownership required: domain */
+static void set_current_fl(int dom_id, bxr_free_list *fl)
+{
+  DEBUGassert(dom_id >= 0 && dom_id < Num_domains);
+  get_domain_state(dom_id)->current_free_list = fl;
+}
+
+/* Statistics about the pools of all domains, which cannot be
+   sharded. */
+static struct {
+  atomic_llong live_pools; // number of tracked pools
+  atomic_llong peak_pools; // max live pools at any time
+  atomic_llong alloced_pools; // number of pools not yet freed
+  atomic_llong committed_pools; // alloced_pools not decommitted
 } stats;
 
+/* Estimate of the memory committed for pools: the committed pools,
+   and the free memory of slabs (see `bxr_slab_free_bytes`). */
+static long long committed_bytes(void)
+{
+  return load_relaxed(&stats.committed_pools) * (long long)BXR_POOL_SIZE
+    + bxr_slab_free_bytes();
+}
+
 // Can be left on, should have no impact on performance unless DEBUG == 1
 #define STATS 1
+#define DOMAIN_STATS(dom_id) (get_domain_state(dom_id)->stats)
+/* The shard of the current thread */
+#define LOCAL_STATS DOMAIN_STATS(bxr_cached_dom_id)
 #if STATS
-#define STATS_INCR(x) (incr(&stats.x))
-#define STATS_DECR(x) (decr(&stats.x))
+#define STATS_INCR(x) (incr(&LOCAL_STATS.x))
+#define STATS_DECR(x) (decr(&LOCAL_STATS.x))
 #else
 #define STATS_INCR(x) ((void)0)
 #define STATS_DECR(x) ((void)0)
 #endif
 
+/* ownership required: domain */
+static void init_pool_rings(int dom_id)
+{
+  pool_rings *local = &get_domain_state(dom_id)->rings;
+  local->old = NULL;
+  local->young = NULL;
+  local->current = NULL;
+  local->free = NULL;
+  local->decommitted = NULL;
+  local->free_target = FREE_POOLS_MIN;
+  local->free_demand = 0;
+  local->old_dir = (pool_dir){ NULL, 0, 0, false };
+  local->young_dir = (pool_dir){ NULL, 0, 0, false };
+  local->node = -1;
+  if (STATS) DOMAIN_STATS(dom_id).free_pools_target += FREE_POOLS_MIN;
+  set_current_fl(dom_id, &empty_fl);
+  domain_state *state = get_domain_state(dom_id);
+  state->sample_countdown = LONG_MAX;
+  state->countdown_mark = LONG_MAX;
+  state->creations = 0;
+  state->minor_epoch = 0;
+  state->major_epoch = 0;
+  state->sampling_rate = 0;
+  state->sampling_seed = 2463534242u + dom_id;
+  pools[dom_id] = local;
+}
+
+/* ownership required: domain */
+static void register_domain_node(pool_rings *local)
+{
+  local->node = bxr_numa_node();
+  incr(&domains_on_node[local->node]);
+}
+
+/* }}} */
+
+/* {{{ Runtime events */
+
+/* With OCaml >= 5.1, Boxroot can emit custom runtime events (see
+   boxroot_events.mli). The events are registered on the OCaml side
+   and given to `boxroot_events_enable`.
+
+   The runtime only lets user events be written through an OCaml
+   primitive, which must not be called inside STW sections nor in the
+   middle of an allocation. Events are therefore queued by domain
+   where they occur, and written at the next safe point of the domain
+   (see `flush_events`). Spans would be timestamped when written:
+   scans and their phases are reported as durations instead. */
+#if OCAML_MULTICORE && OCAML_VERSION >= 50100
+#define RUNTIME_EVENTS 1
+#else
+#define RUNTIME_EVENTS 0
+#endif
+
+enum {
+  /* durations, queued in clock ticks */
+  EV_MINOR_SCAN,
+  EV_MAJOR_SCAN,
+  EV_GC_POOL_RINGS,
+  EV_ADOPT_ORPHANS,
+  NUM_DURATION_EVENTS,
+  /* counts */
+  EV_SCANNED_POOLS = NUM_DURATION_EVENTS, // pools scanned
+  EV_SCAN_WORK, // work of the scan
+  EV_POOL_ALLOC, // pools allocated, after an allocation
+  EV_POOL_FREE, // pools allocated, after a release
+  NUM_EVENTS
+};
+
+#if RUNTIME_EVENTS
+
+/* The runtime does not export it in a header. Uses CAMLparam: only
+   call it from `flush_events`. */
+CAMLextern value caml_runtime_events_user_write(value write_buffer,
+                                                value event,
+                                                value event_content);
+
+/* Generational global roots, set once by `boxroot_events_enable` */
+static value events[NUM_EVENTS];
+static atomic_bool events_enabled = false;
+
+/* Enough for the events of a few scans. Further events are dropped
+   until the next flush. */
+#define PENDING_EVENTS 32
+
+typedef struct {
+  int len;
+  struct { int ev; long long n; } items[PENDING_EVENTS];
+} event_queue;
+
+/* Only accessed by the domain, with its lock or during its part of a
+   STW section. */
+static event_queue pending_events[Num_domains];
+
+/* ownership required: domain */
+static void queue_event(int ev, long long n)
+{
+  if (!load_relaxed(&events_enabled)) return;
+  int dom_id = Domain_id;
+  if (dom_id < 0) return;
+  event_queue *q = &pending_events[dom_id];
+  if (ev == EV_POOL_ALLOC || ev == EV_POOL_FREE) {
+    /* Only the last count matters: coalesce */
+    for (int i = 0; i < q->len; i++) {
+      if (q->items[i].ev == ev) { q->items[i].n = n; return; }
+    }
+  }
+  if (q->len == PENDING_EVENTS) return;
+  q->items[q->len].ev = ev;
+  q->items[q->len].n = n;
+  q->len++;
+}
+
+/* Write the queued events of the current domain. */
+/* ownership required: current domain, outside of STW sections and of
+   allocations */
+static void flush_events(void)
+{
+  int dom_id = Domain_id;
+  if (dom_id < 0) return;
+  event_queue *q = &pending_events[dom_id];
+  if (BXR_LIKELY(q->len == 0)) return;
+  int len = q->len;
+  q->len = 0;
+  if (!load_relaxed(&events_enabled)) return;
+  double ns_per_tick = bxr_ns_per_tick();
+  for (int i = 0; i < len; i++) {
+    int ev = q->items[i].ev;
+    long long n = q->items[i].n;
+    if (ev < NUM_DURATION_EVENTS) n = (long long)((double)n * ns_per_tick);
+    /* The write buffer is only used by events of custom types. */
+    caml_runtime_events_user_write(Val_unit, events[ev], Val_long(n));
+  }
+}
+
+/* [evs] is an array of events of type `int`, in the order of the
+   enum. */
+value boxroot_events_enable(value evs)
+{
+  CAMLparam1(evs);
+  if (Wosize_val(evs) != NUM_EVENTS)
+    caml_invalid_argument("boxroot_events_enable");
+  if (!load_relaxed(&events_enabled)) {
+    for (int i = 0; i < NUM_EVENTS; i++) {
+      events[i] = Field(evs, i);
+      caml_register_generational_global_root(&events[i]);
+    }
+    atomic_store(&events_enabled, true);
+  }
+  CAMLreturn(Val_unit);
+}
+
+value boxroot_events_flush(value unit)
+{
+  flush_events();
+  return Val_unit;
+}
+
+static void disable_events(void)
+{
+  atomic_store(&events_enabled, false);
+}
+
+#else
+
+static void queue_event(int ev, long long n) {}
+static void flush_events(void) {}
+static void disable_events(void) {}
+
+#endif // RUNTIME_EVENTS
+
+#define EMIT_DURATION(ev, ticks) queue_event((ev), (ticks))
+#define EMIT_INT(ev, n) queue_event((ev), (n))
+
 /* }}} */
 
 /* {{{ Tests in the hot path */
@@ -299,6 +625,65 @@ static pool * ring_pop(pool **target)
 
 /* }}} */
 
+/* {{{ Pool directories */
+
+/* ownership required: domain */
+static inline pool_dir * class_dir(pool_rings *local, int cl)
+{
+  DEBUGassert(cl == OLD || cl == YOUNG);
+  return (cl == OLD) ? &local->old_dir : &local->young_dir;
+}
+
+/* Empty the directory and free its memory. */
+/* ownership required: domain */
+static void release_dir(pool_dir *dir)
+{
+  for (int i = 0; i < dir->len; i++) dir->pools[i]->dir_index = -1;
+  free(dir->pools);
+  dir->pools = NULL;
+  dir->len = 0;
+  dir->capacity = 0;
+}
+
+/* Record [p], which has just been pushed to the ring of class [cl]
+   of domain [dom_id]. */
+/* ownership required: domain, pool */
+static void dir_add(int dom_id, int cl, pool *p)
+{
+  pool_dir *dir = class_dir(pools[dom_id], cl);
+  DEBUGassert(p->dir_index == -1);
+  if (dir->failed) return;
+  if (dir->len == dir->capacity) {
+    int capacity = (dir->capacity == 0) ? 64 : 2 * dir->capacity;
+    pool **a = realloc(dir->pools, capacity * sizeof(pool *));
+    if (a == NULL) {
+      /* Not worth failing for: fall back to the ring. */
+      release_dir(dir);
+      dir->failed = true;
+      return;
+    }
+    dir->pools = a;
+    dir->capacity = capacity;
+  }
+  p->dir_index = dir->len;
+  dir->pools[dir->len++] = p;
+}
+
+/* Forget [p], which is about to be popped from its ring. */
+/* ownership required: domain, pool */
+static void dir_remove(pool *p)
+{
+  if (p->dir_index < 0) return;
+  pool_dir *dir = class_dir(pools[p->free_list.domain_id],
+                            p->free_list.class);
+  pool *last = dir->pools[--dir->len];
+  dir->pools[p->dir_index] = last;
+  last->dir_index = p->dir_index;
+  p->dir_index = -1;
+}
+
+/* }}} */
+
 /* {{{ Pool management */
 
 /* the empty free-list for a pool p is denoted by a pointer to the
@@ -309,35 +694,105 @@ static inline bxr_slot_ref empty_free_list(pool *p) { return (bxr_slot_ref)p; }
 /* ownership required: pool */
 static inline bool is_full_pool(pool *p)
 {
-  return is_empty_free_list(p->free_list.next, p);
+  return is_empty_free_list(p->free_list.next, p) && p->bump == POOL_CAPACITY;
 }
 
-/* ownership required: none */
-static pool * get_empty_pool()
+/* Hand the next chunk of fresh slots to the free list. */
+/* ownership required: pool */
+static void carve_slots(pool *p)
 {
-  pool *p = bxr_alloc_uninitialised_pool(BXR_POOL_SIZE);
-  if (p == NULL) return NULL;
-  if (STATS) {
-    long long live_pools = 1 + incr(&stats.live_pools);
-    /* racy, but whatever */
-    if (live_pools > stats.peak_pools) stats.peak_pools = live_pools;
+  DEBUGassert(p->bump < POOL_CAPACITY);
+  bxr_slot_ref start = &p->roots[p->bump];
+  int chunk = (p->bump < CARVE_MIN_SLOTS) ? CARVE_MIN_SLOTS : p->bump;
+  bxr_slot_ref end = (chunk < POOL_CAPACITY - p->bump)
+    ? start + chunk : &p->roots[POOL_CAPACITY];
+  bxr_slot_ref page_end =
+    (bxr_slot_ref)(((uintptr_t)start + CARVE_SIZE) & ~(CARVE_SIZE - 1));
+  if (page_end < end) end = page_end;
+  bxr_slot_ref next = p->free_list.next;
+  if (is_empty_free_list(next, p)) p->free_list.end = end - 1;
+  (end - 1)->as_slot_ref = next;
+  for (bxr_slot_ref s = end - 2; s >= start; --s) {
+    s->as_slot_ref = s + 1;
   }
-  STATS_INCR(total_alloced_pools);
+  p->free_list.next = start;
+  p->bump = end - p->roots;
+}
+
+/* Forget the slots of an empty pool: they are handed to the free
+   list again from the start, which resets the high-water mark. */
+/* ownership required: pool */
+static void reset_empty_pool(pool *p)
+{
+  DEBUGassert(p->free_list.alloc_count == 0);
+  DEBUGassert(load_relaxed(&p->delayed_fl.a_alloc_count) == 0);
+  p->bump = 0;
+  p->last_live = 0;
+  p->free_list.next = empty_free_list(p);
+  p->free_list.end = NULL;
+}
+
+/* Initialise the header. The slots are initialised lazily. */
+/* ownership required: pool */
+static void init_pool(pool *p)
+{
   ring_link(p, p);
-  p->free_list.next = p->roots;
+  p->bump = 0;
+  p->dir_index = -1;
+  p->free_list.next = empty_free_list(p);
   p->free_list.alloc_count = 0;
-  p->free_list.end = &p->roots[POOL_CAPACITY - 1];
+  p->free_list.end = NULL;
   p->free_list.domain_id = -1;
   p->free_list.class = UNTRACKED;
+  p->free_list.sampled = 0;
+  p->birth_minor = 0;
+  p->birth_major = 0;
+  p->last_live = 0;
   store_relaxed(&p->delayed_fl.a_next, empty_free_list(p));
   store_relaxed(&p->delayed_fl.a_alloc_count, 0);
   p->delayed_fl.end = NULL;
-  bxr_initialize_mutex(&p->mutex);
-  /* We end the free_list with a dummy value which satisfies is_pool_member */
-  p->roots[POOL_CAPACITY - 1].as_slot_ref = empty_free_list(p);
-  for (bxr_slot_ref s = p->roots + POOL_CAPACITY - 2; s >= p->roots; --s) {
-    s->as_slot_ref = s + 1;
-  }
+  store_relaxed(&p->lockless_deleters, 0);
+}
+
+/* Allocate a pool on the NUMA node of the current thread. */
+/* ownership required: none */
+static pool * get_empty_pool()
+{
+  int node = bxr_numa_node();
+  pool *p = bxr_alloc_uninitialised_pool_on_node(BXR_POOL_SIZE, node);
+  if (p == NULL) return NULL;
+  p->node = node;
+  STATS_INCR(total_alloced_pools);
+  if (STATS) incr(&stats.committed_pools);
+  EMIT_INT(EV_POOL_ALLOC, 1 + incr(&stats.alloced_pools));
+  init_pool(p);
+  return p;
+}
+
+/* Give the memory of an empty pool back to the OS, except for the
+   header. Its free list becomes invalid. Returns false, leaving the
+   pool untouched, if its memory cannot be decommitted separately
+   (see `bxr_decommit_pool`). */
+/* ownership required: pool */
+static bool decommit_pool(pool *p)
+{
+  DEBUGassert(p->free_list.class == UNTRACKED);
+  if (!bxr_decommit_pool(p, BXR_POOL_SIZE, sizeof(pool))) return false;
+  /* Denotes an uninitialised pool, see validate_pool */
+  p->free_list.next = NULL;
+  STATS_INCR(total_decommitted_pools);
+  STATS_INCR(decommitted_pools);
+  if (STATS) decr(&stats.committed_pools);
+  return true;
+}
+
+/* ownership required: pool */
+static pool * recommit_pool(pool *p)
+{
+  init_pool(p);
+  STATS_INCR(total_recommitted_pools);
+  STATS_DECR(decommitted_pools);
+  if (STATS) incr(&stats.committed_pools);
   return p;
 }
 
@@ -348,6 +803,21 @@ static int anticipated_alloc_count(pool *p)
   return p->free_list.alloc_count + load_relaxed(&p->delayed_fl.a_alloc_count);
 }
 
+/* Wait until the lock-less deallocations in progress on [p] are
+   done. Once [scanning_domains] has been incremented, no new one can
+   start. */
+/* ownership required: STW (or the current domain lock + knowledge
+   that no other thread owns slots) */
+static void quiesce_pool(pool *p)
+{
+  /* seq_cst: pairs with the seq_cst operations in
+     free_slots_lockless. Acquire: synchronizes with decr_release. */
+  if (BXR_LIKELY(!atomic_load(&lockless_deletion_seen)
+                 && atomic_load(&boundary_flushers) == 0)) return;
+  while (BXR_UNLIKELY(atomic_load(&p->lockless_deleters) != 0))
+    bxr_cpu_relax();
+}
+
 /* ownership required: STW (or the current domain lock + knowledge
    that no other thread owns slots)
 
@@ -355,70 +825,325 @@ static int anticipated_alloc_count(pool *p)
 */
 static int gc_pool(pool *p)
 {
+  quiesce_pool(p);
   int old_alloc_count = load_relaxed(&p->delayed_fl.a_alloc_count);
   if (0 == old_alloc_count) return 0;
-  bxr_mutex_lock(&p->mutex);
-  if (is_full_pool(p)) p->free_list.end = p->delayed_fl.end;
+  if (is_empty_free_list(p->free_list.next, p))
+    p->free_list.end = p->delayed_fl.end;
   p->free_list.alloc_count = anticipated_alloc_count(p);
   store_relaxed(&p->delayed_fl.a_alloc_count, 0);
   bxr_slot_ref list = p->free_list.next;
   p->free_list.next = load_relaxed(&p->delayed_fl.a_next);
   store_relaxed(&p->delayed_fl.a_next, empty_free_list(p));
   p->delayed_fl.end->as_slot_ref = list;
-  bxr_mutex_unlock(&p->mutex);
   return old_alloc_count;
 }
 
+/* Returns the number of freed pools */
 /* ownership required: ring */
-static void free_pool_ring(pool **ring)
+static int free_pool_ring(pool **ring)
 {
+  int freed = 0;
   while (*ring != NULL) {
     pool *p = ring_pop(ring);
+    /* A lock-less deleter could still be leaving the pool */
+    quiesce_pool(p);
     bxr_free_pool(p);
     STATS_INCR(total_freed_pools);
+    if (STATS) decr(&stats.committed_pools);
+    EMIT_INT(EV_POOL_FREE, decr(&stats.alloced_pools) - 1);
+    freed++;
+  }
+  return freed;
+}
+
+/* ownership required: ring */
+static void free_decommitted_ring(pool **ring)
+{
+  int freed = free_pool_ring(ring);
+  if (STATS) {
+    LOCAL_STATS.decommitted_pools -= freed;
+    /* They were no longer counted as committed */
+    stats.committed_pools += freed;
   }
 }
 
 /* ownership required: rings */
 static void free_pool_rings(pool_rings *ps)
 {
+  release_dir(&ps->old_dir);
+  release_dir(&ps->young_dir);
   free_pool_ring(&ps->old);
   free_pool_ring(&ps->young);
   free_pool_ring(&ps->current);
   free_pool_ring(&ps->free);
+  free_decommitted_ring(&ps->decommitted);
+}
+
+/* Apply the retention policy for empty pools: release the pools
+   decommitted at the previous major root scanning that have not been
+   reused since, keep `free_target` empty pools, and decommit the
+   rest. `free_target` follows the demand for empty pools since the
+   previous major root scanning, decaying by half when the demand
+   falls, within [FREE_POOLS_MIN, FREE_POOLS_MAX].
+
+   Pools from slabs cannot be decommitted one by one without
+   splitting huge pages: they are freed instead, and their memory
+   goes back to the OS with their slab, once all the pools of the
+   slab are freed (see platform.c). */
+/* ownership required: domain */
+static void trim_free_pools(int dom_id)
+{
+  pool_rings *local = pools[dom_id];
+  free_decommitted_ring(&local->decommitted);
+  int target = local->free_target / 2;
+  if (local->free_demand > target) target = local->free_demand;
+  if (target < FREE_POOLS_MIN) target = FREE_POOLS_MIN;
+  if (target > FREE_POOLS_MAX) target = FREE_POOLS_MAX;
+  if (STATS)
+    DOMAIN_STATS(dom_id).free_pools_target += target - local->free_target;
+  local->free_target = target;
+  local->free_demand = 0;
+  pool *kept = NULL;
+  pool *to_free = NULL;
+  for (int n = 0; local->free != NULL; n++) {
+    pool *p = ring_pop(&local->free);
+    if (n < target) {
+      ring_push_back(p, &kept);
+    } else if (decommit_pool(p)) {
+      ring_push_back(p, &local->decommitted);
+    } else {
+      ring_push_back(p, &to_free);
+    }
+  }
+  local->free = kept;
+  free_pool_ring(&to_free);
 }
 
 /* }}} */
 
-/* {{{ Pool class management */
+/* {{{ Root lifetimes */
+
+/* The lifetimes of boxroots are measured in numbers of minor and
+   major scans of their domain, without per-slot work:
+   - the boxroots of a pool are considered born when the pool last
+     became current, at which point the pool is stamped with the
+     epochs of its domain;
+   - the deaths in a pool are observed by comparing its number of
+     allocated slots with that at the last observation, and counted
+     at the age of the pool. Young pools are observed at every scan,
+     old pools at major scans only; all pools are also observed when
+     they become empty or current again;
+   - boxroots that die before the first scan after their creation
+     are never seen in a pool. Their number is the number of
+     creations (counted on the sampling countdown, see
+     `set_countdown`) minus the net gain of the pools stamped during
+     the same period. */
 
-/* ownership required: pool */
-static inline bool is_not_too_full(pool *p)
+typedef struct {
+  atomic_llong deaths_by_minors[BOXROOT_LIFETIME_BUCKETS];
+  atomic_llong deaths_by_majors[BOXROOT_LIFETIME_BUCKETS];
+  /* Snapshot taken at the last major scan */
+  atomic_llong live_by_majors[BOXROOT_LIFETIME_BUCKETS];
+} lifetime_histograms;
+
+/* Written by each domain for its own index. */
+static lifetime_histograms lifetimes[Num_domains];
+
+static int log2_floor(unsigned long long x)
 {
-  return p->free_list.alloc_count <= (int)(BXR_DEALLOC_THRESHOLD / sizeof(bxr_slot));
+#if defined(__GNUC__)
+  return 63 - __builtin_clzll(x);
+#else
+  int e = 0;
+  while (x >>= 1) e++;
+  return e;
+#endif
 }
 
-/* Change the current pool from NULL to p */
-/* ownership required: domain, pool */
-static void set_current_pool(int dom_id, pool *p)
+/* Bucket 0 holds age 0, bucket k > 0 holds ages in [2^(k-1), 2^k). */
+static int lifetime_bucket(int age)
 {
-  pool_rings *local = pools[dom_id];
-  DEBUGassert(local->current == NULL);
-  if (p == NULL) return;
-  DEBUGassert(p->next == p);
-  p->free_list.domain_id = dom_id;
-  local->current = p;
-  p->free_list.class = YOUNG;
-  // Prevent the current pool from triggering a slow deallocation
-  // path when empty.
-  p->free_list.alloc_count++;
-  set_current_fl(dom_id, &p->free_list);
+  if (age <= 0) return 0;
+  int b = log2_floor(age) + 1;
+  return (b < BOXROOT_LIFETIME_BUCKETS) ? b : BOXROOT_LIFETIME_BUCKETS - 1;
 }
 
-static void reclassify_pool(pool **source, int dom_id, int cl);
+/* ownership required: domain */
+static void record_deaths(int dom_id, int minors, int majors, long long n)
+{
+  lifetime_histograms *h = &lifetimes[dom_id];
+  h->deaths_by_minors[lifetime_bucket(minors)] += n;
+  h->deaths_by_majors[lifetime_bucket(majors)] += n;
+  if (STATS) {
+    DOMAIN_STATS(dom_id).total_deaths += n;
+    if (minors == 0) DOMAIN_STATS(dom_id).deaths_before_minor += n;
+  }
+}
 
-/* Empty the current pool ring onto the young pool ring. */
-static void move_current_to_young(int dom_id)
+/* Record the deaths in [p] since it was last observed, given its
+   current number of allocated slots. Return the net gain instead if
+   the pool has more allocated slots than when last observed. */
+/* ownership required: domain, pool */
+static int observe_deaths(int dom_id, pool *p, int live)
+{
+  domain_state *state = get_domain_state(dom_id);
+  int died = p->last_live - live;
+  p->last_live = live;
+  if (died <= 0) return -died;
+  record_deaths(dom_id, state->minor_epoch - p->birth_minor,
+                state->major_epoch - p->birth_major, died);
+  return 0;
+}
+
+/* The pool is about to receive new boxroots */
+/* ownership required: domain, pool */
+static void stamp_pool(int dom_id, pool *p)
+{
+  domain_state *state = get_domain_state(dom_id);
+  observe_deaths(dom_id, p, p->free_list.alloc_count);
+  p->birth_minor = state->minor_epoch;
+  p->birth_major = state->major_epoch;
+}
+
+/* Pools leaving a domain keep their age: their epochs are made
+   relative to the domain's, and made absolute again by the adopting
+   domain. */
+/* ownership required: ring, domain */
+static void rebase_ring(pool *ring, int dom_id, int sign)
+{
+  if (ring == NULL) return;
+  domain_state *state = get_domain_state(dom_id);
+  pool *p = ring;
+  do {
+    p->birth_minor += sign * state->minor_epoch;
+    p->birth_major += sign * state->major_epoch;
+    p = p->next;
+  } while (p != ring);
+}
+
+/* Fold the consumed part of the countdown into `creations` before it
+   is overwritten. */
+/* ownership required: domain */
+static void set_countdown(domain_state *state, long countdown)
+{
+  state->creations += state->countdown_mark - state->sample_countdown;
+  state->sample_countdown = countdown;
+  state->countdown_mark = countdown;
+}
+
+/* The number of boxroots created since the last call */
+/* ownership required: domain */
+static long long take_creations(domain_state *state)
+{
+  set_countdown(state, state->sample_countdown);
+  long long n = state->creations;
+  state->creations = 0;
+  return n;
+}
+
+/* A tracked pool is sparse when at most 1/SPARSE_POOL_RATIO of its
+   slots are allocated. Remote deallocations can leave many of them
+   behind (see `bxr_create_slow`). */
+#define SPARSE_POOL_RATIO 8
+
+/* What the observation of the pools of a scan finds */
+typedef struct {
+  long long gained;
+  long long live[BOXROOT_LIFETIME_BUCKETS];
+  long long sparse;
+} observation;
+
+/* ownership required: STW */
+static void observe_pool(int dom_id, pool *p, bool only_young,
+                         observation *o)
+{
+  domain_state *state = get_domain_state(dom_id);
+  int n = p->free_list.alloc_count;
+  o->gained += observe_deaths(dom_id, p, n);
+  if (!only_young) {
+    o->live[lifetime_bucket(state->major_epoch - p->birth_major)] += n;
+    if (n <= POOL_CAPACITY / SPARSE_POOL_RATIO) o->sparse++;
+  }
+}
+
+/* Like `scan_dir`, iterate over the directory of [ring], which the
+   scan has just brought into cache, rather than follow the ring
+   links. */
+/* ownership required: STW */
+static void observe_dir(int dom_id, pool_dir *dir, pool *ring,
+                        bool only_young, observation *o)
+{
+  if (!dir->failed) {
+    for (int i = 0; i < dir->len; i++)
+      observe_pool(dom_id, dir->pools[i], only_young, o);
+    return;
+  }
+  pool *p = ring;
+  if (p == NULL) return;
+  do {
+    observe_pool(dom_id, p, only_young, o);
+    p = p->next;
+  } while (p != ring);
+}
+
+/* Observe the pools scanned, account for the boxroots that died
+   before being seen, and advance the epoch. At major scans, also
+   count the sparse pools. */
+/* ownership required: STW */
+static void observe_lifetimes(int dom_id, bool only_young)
+{
+  pool_rings *local = pools[dom_id];
+  domain_state *state = get_domain_state(dom_id);
+  observation o = { 0 };
+  observe_dir(dom_id, &local->young_dir, local->young, only_young, &o);
+  if (!only_young)
+    observe_dir(dom_id, &local->old_dir, local->old, only_young, &o);
+  long long died = take_creations(state) - o.gained;
+  if (died > 0) record_deaths(dom_id, 0, 0, died);
+  if (only_young) {
+    state->minor_epoch++;
+  } else {
+    for (int b = 0; b < BOXROOT_LIFETIME_BUCKETS; b++)
+      store_relaxed(&lifetimes[dom_id].live_by_majors[b], o.live[b]);
+    if (STATS) store_relaxed(&state->stats.sparse_pools, o.sparse);
+    state->major_epoch++;
+  }
+}
+
+/* }}} */
+
+/* {{{ Pool class management */
+
+/* ownership required: pool */
+static inline bool is_not_too_full(pool *p)
+{
+  return p->free_list.alloc_count <= (int)(BXR_DEALLOC_THRESHOLD / sizeof(bxr_slot));
+}
+
+/* Change the current pool from NULL to p */
+/* ownership required: domain, pool */
+static void set_current_pool(int dom_id, pool *p)
+{
+  pool_rings *local = pools[dom_id];
+  DEBUGassert(local->current == NULL);
+  if (p == NULL) return;
+  DEBUGassert(p->next == p);
+  p->free_list.domain_id = dom_id;
+  stamp_pool(dom_id, p);
+  local->current = p;
+  p->free_list.class = YOUNG;
+  if (is_empty_free_list(p->free_list.next, p)) carve_slots(p);
+  // Prevent the current pool from triggering a slow deallocation
+  // path when empty.
+  p->free_list.alloc_count++;
+  set_current_fl(dom_id, &p->free_list);
+}
+
+static void reclassify_pool(pool **source, int dom_id, int cl);
+
+/* Empty the current pool ring onto the young pool ring. */
+static void move_current_to_young(int dom_id)
 {
   pool_rings *local = pools[dom_id];
   if (local->current != NULL) {
@@ -458,6 +1183,7 @@ static inline pool * pop_available(pool **target)
      first one is full, then none of the next ones are empty
      enough. */
   if (*target == NULL || is_full_pool(*target)) return NULL;
+  dir_remove(*target);
   return ring_pop(target);
 }
 
@@ -470,8 +1196,19 @@ static void find_and_set_available_pool(int dom_id)
   pool *p = pop_available(&local->young);
   if (p == NULL && local->old != NULL && is_not_too_full(local->old))
     p = pop_available(&local->old);
-  if (p == NULL) p = pop_available(&local->free);
-  if (p == NULL) p = get_empty_pool();
+  if (p == NULL) {
+    local->free_demand++;
+    p = pop_available(&local->free);
+    if (p == NULL && local->decommitted != NULL)
+      p = recommit_pool(ring_pop(&local->decommitted));
+    if (p == NULL) p = get_empty_pool();
+    /* The pool becomes tracked, whichever ring it came from */
+    if (STATS && p != NULL) {
+      long long live_pools = 1 + incr(&stats.live_pools);
+      /* racy, but whatever */
+      if (live_pools > stats.peak_pools) stats.peak_pools = live_pools;
+    }
+  }
   DEBUGassert(local->current == NULL);
   DEBUGassert(!is_full_pool(p));
   set_current_pool(dom_id, p);
@@ -487,6 +1224,7 @@ static void reclassify_pool(pool **source, int dom_id, int cl)
 {
   DEBUGassert(*source != NULL);
   pool_rings *local = pools[dom_id];
+  dir_remove(*source);
   pool *p = ring_pop(source);
   p->free_list.domain_id = dom_id;
   pool **target = NULL;
@@ -495,13 +1233,16 @@ static void reclassify_pool(pool **source, int dom_id, int cl)
   case YOUNG: target = &local->young; break;
   case UNTRACKED:
     target = &local->free;
+    observe_deaths(dom_id, p, 0);
+    reset_empty_pool(p);
     STATS_INCR(total_emptied_pools);
-    STATS_DECR(live_pools);
+    if (STATS) decr(&stats.live_pools);
     break;
   }
   /* protected by domain lock */
   p->free_list.class = cl;
   ring_push_back(p, target);
+  if (cl != UNTRACKED) dir_add(dom_id, cl, p);
   /* make p the new head of [*target] (rotate one step backwards) if
      it is not too full. */
   if (is_not_too_full(p)) *target = p;
@@ -531,6 +1272,404 @@ static void promote_young_pools(int dom_id)
 
 /* }}} */
 
+/* {{{ Allocation-site profiling */
+
+/* See `boxroot_set_sampling`. Samples live in hash tables keyed by
+   boxroot, and `sampled` in the header of a pool counts its samples,
+   so that `boxroot_delete` only looks up a table for the pools that
+   have some. The tables are sharded by pool, each with its own
+   mutex: deletions in pools with samples only contend with the other
+   threads using the pools of the same shard. */
+
+#define PROFILE_DEPTH 16
+#define SAMPLE_SHARDS 64
+
+typedef struct sample {
+  struct sample *next;
+  boxroot root;
+  int depth;
+  void *frames[PROFILE_DEPTH];
+} sample;
+
+/* Each shard is owned by its mutex, as well as the `sampled` field of
+   the pools it holds. The mutexes are initialised by `setup`. */
+typedef struct {
+  mutex_t mutex;
+  sample **buckets;
+  size_t size; // zero or a power of two
+  size_t count;
+} sample_shard;
+
+static sample_shard samples[SAMPLE_SHARDS];
+
+/* One sample every `sampling_rate` creations, 0 if disabled */
+static atomic_int sampling_rate = 0;
+
+void boxroot_set_sampling(int n)
+{
+  store_relaxed(&sampling_rate, n > 0 ? n : 0);
+}
+
+static sample_shard * shard_of_pool(bxr_free_list *fl)
+{
+  uintptr_t h = ((uintptr_t)fl >> BXR_POOL_LOG_SIZE)
+    * (uintptr_t)0x9E3779B97F4A7C15ULL;
+  return &samples[(h >> 32) % SAMPLE_SHARDS];
+}
+
+static size_t sample_hash(boxroot root, size_t size)
+{
+  return (((uintptr_t)root >> 3) * (uintptr_t)0x9E3779B97F4A7C15ULL)
+    & (size - 1);
+}
+
+/* ownership required: shard */
+static bool grow_samples(sample_shard *sh)
+{
+  size_t size = sh->size == 0 ? 64 : 2 * sh->size;
+  sample **buckets = calloc(size, sizeof(sample *));
+  if (buckets == NULL) return false;
+  for (size_t i = 0; i < sh->size; i++) {
+    sample *smp = sh->buckets[i];
+    while (smp != NULL) {
+      sample *next = smp->next;
+      size_t h = sample_hash(smp->root, size);
+      smp->next = buckets[h];
+      buckets[h] = smp;
+      smp = next;
+    }
+  }
+  free(sh->buckets);
+  sh->buckets = buckets;
+  sh->size = size;
+  return true;
+}
+
+/* ownership required: root */
+static void record_sample(boxroot root)
+{
+  sample *smp = malloc(sizeof(sample));
+  if (smp == NULL) return;
+  smp->root = root;
+  smp->depth = bxr_backtrace(smp->frames, PROFILE_DEPTH);
+  bxr_free_list *fl = Bxr_get_pool_header(root);
+  sample_shard *sh = shard_of_pool(fl);
+  bxr_mutex_lock(&sh->mutex);
+  if (sh->count >= sh->size && !grow_samples(sh)) {
+    bxr_mutex_unlock(&sh->mutex);
+    free(smp);
+    return;
+  }
+  size_t h = sample_hash(root, sh->size);
+  smp->next = sh->buckets[h];
+  sh->buckets[h] = smp;
+  sh->count++;
+  fl->sampled++;
+  bxr_mutex_unlock(&sh->mutex);
+}
+
+/* ownership required: root */
+void bxr_forget_sample(bxr_free_list *fl, boxroot root)
+{
+  sample_shard *sh = shard_of_pool(fl);
+  bxr_mutex_lock(&sh->mutex);
+  if (sh->size == 0) goto out;
+  sample **link = &sh->buckets[sample_hash(root, sh->size)];
+  while (*link != NULL && (*link)->root != root) link = &(*link)->next;
+  sample *smp = *link;
+  if (smp == NULL) goto out;
+  *link = smp->next;
+  sh->count--;
+  fl->sampled--;
+  free(smp);
+ out:
+  bxr_mutex_unlock(&sh->mutex);
+}
+
+/* Uniform in [1, 2 * rate - 1], LONG_MAX if disabled */
+/* ownership required: domain */
+static long next_sample_countdown(domain_state *state)
+{
+  if (state->sampling_rate == 0) return LONG_MAX;
+  /* xorshift32 */
+  uint32_t x = state->sampling_seed;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  state->sampling_seed = x;
+  return 1 + (long)(x % (2 * (uint32_t)state->sampling_rate - 1));
+}
+
+/* ownership required: domain */
+static void restart_countdown(domain_state *state)
+{
+  state->sampling_rate = load_relaxed(&sampling_rate);
+  set_countdown(state, next_sample_countdown(state));
+}
+
+/* Is the countdown of the domain over, or has the sampling rate
+   changed? */
+
+/* ownership required: domain */
+static bool sampling_pending(int dom_id)
+{
+  domain_state *state = get_domain_state(dom_id);
+  return state->sample_countdown <= 0
+    || state->sampling_rate != load_relaxed(&sampling_rate);
+}
+
+typedef struct {
+  sample *first; // representative
+  long count;
+} site;
+
+static int compare_frames(const sample *a, const sample *b)
+{
+  if (a->depth != b->depth) return a->depth - b->depth;
+  return memcmp(a->frames, b->frames, a->depth * sizeof(void *));
+}
+
+static int compare_samples(const void *a, const void *b)
+{
+  return compare_frames(*(sample *const *)a, *(sample *const *)b);
+}
+
+static int compare_sites(const void *a, const void *b)
+{
+  long ca = ((const site *)a)->count, cb = ((const site *)b)->count;
+  return (ca < cb) - (ca > cb);
+}
+
+/* Copy the samples of [sh] at the end of [*all], of length [*n].
+   Returns false if out of memory. */
+static bool copy_samples(sample_shard *sh, sample **all, size_t *n)
+{
+  bxr_mutex_lock(&sh->mutex);
+  bool ok = true;
+  if (sh->count != 0) {
+    sample *grown = realloc(*all, (*n + sh->count) * sizeof(sample));
+    if (grown == NULL) {
+      ok = false;
+    } else {
+      *all = grown;
+      for (size_t i = 0; i < sh->size; i++)
+        for (sample *smp = sh->buckets[i]; smp != NULL; smp = smp->next)
+          (*all)[(*n)++] = *smp;
+    }
+  }
+  bxr_mutex_unlock(&sh->mutex);
+  return ok;
+}
+
+/* The samples are copied shard by shard, so that deletions are not
+   held up while the backtraces are symbolised. */
+void boxroot_dump_profile(int fd, int top)
+{
+  sample *all = NULL;
+  size_t n = 0;
+  site *sites = NULL;
+  /* Before setup, there are no samples (nor mutexes) */
+  for (int i = 0; i < SAMPLE_SHARDS
+         && boxroot_status() != BOXROOT_NOT_SETUP; i++)
+    if (!copy_samples(&samples[i], &all, &n)) goto out;
+  sample **sorted = malloc((n + 1) * sizeof(sample *));
+  sites = malloc((n + 1) * sizeof(site));
+  if (sorted == NULL || sites == NULL) { free(sorted); goto out; }
+  for (size_t i = 0; i < n; i++) sorted[i] = &all[i];
+  /* Group the samples by backtrace */
+  qsort(sorted, n, sizeof(sample *), &compare_samples);
+  size_t num_sites = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (num_sites == 0
+        || compare_frames(sites[num_sites - 1].first, sorted[i]))
+      sites[num_sites++] = (site){ sorted[i], 0 };
+    sites[num_sites - 1].count++;
+  }
+  free(sorted);
+  qsort(sites, num_sites, sizeof(site), &compare_sites);
+  int rate = load_relaxed(&sampling_rate);
+  dprintf(fd, "%zu live samples from %zu allocation sites"
+          " (sampling rate: 1/%d)\n", n, num_sites, rate);
+  for (size_t i = 0; i < num_sites && i < (size_t)top; i++) {
+    dprintf(fd, "\n#%zu: %ld samples (~%ld boxroots)\n",
+            i + 1, sites[i].count, sites[i].count * rate);
+    bxr_print_backtrace(fd, sites[i].first->frames, sites[i].first->depth);
+  }
+ out:
+  free(all);
+  free(sites);
+}
+
+/* ownership required: none (OCaml has shut down) */
+static void free_samples(void)
+{
+  for (int k = 0; k < SAMPLE_SHARDS; k++) {
+    sample_shard *sh = &samples[k];
+    bxr_mutex_lock(&sh->mutex);
+    for (size_t i = 0; i < sh->size; i++) {
+      sample *smp = sh->buckets[i];
+      while (smp != NULL) {
+        sample *next = smp->next;
+        free(smp);
+        smp = next;
+      }
+    }
+    free(sh->buckets);
+    sh->buckets = NULL;
+    sh->size = 0;
+    sh->count = 0;
+    bxr_mutex_unlock(&sh->mutex);
+  }
+}
+
+/* }}} */
+
+/* {{{ Tracing */
+
+/* See `boxroot_trace_start`. Each thread fills a buffer of records,
+   which it writes to the file under `trace_mutex` when full. Buffers
+   are kept until `boxroot_trace_stop`, so that the records of
+   terminated threads are written too. */
+
+#define TRACE_BUFFER_RECORDS 4096
+
+typedef struct trace_buffer {
+  struct trace_buffer *next;
+  uint32_t thread;
+  int len;
+  struct boxroot_trace_record records[TRACE_BUFFER_RECORDS];
+} trace_buffer;
+
+bool bxr_tracing = false;
+
+/* Owned by trace_mutex */
+static mutex_t trace_mutex = BXR_MUTEX_INITIALIZER;
+static FILE *trace_file = NULL;
+static trace_buffer *trace_buffers = NULL;
+static uint32_t trace_threads = 0;
+
+static atomic_ullong trace_seq = 0;
+/* Incremented by each trace, to recognise buffers of previous
+   traces. */
+static atomic_uint trace_generation = 0;
+
+static _Thread_local trace_buffer *trace_local = NULL;
+static _Thread_local unsigned trace_local_generation = 0;
+/* Set while an operation records itself differently than as the
+   sum of its parts (see `bxr_modify_slow`). */
+static _Thread_local bool trace_muted = false;
+
+/* ownership required: trace_mutex */
+static void write_trace_buffer(trace_buffer *b)
+{
+  if (trace_file != NULL && b->len > 0)
+    fwrite(b->records, sizeof(b->records[0]), b->len, trace_file);
+  b->len = 0;
+}
+
+/* The buffer of the current thread, NULL if there is no trace or in
+   case of allocation failure */
+static trace_buffer * get_trace_buffer(void)
+{
+  unsigned generation = load_relaxed(&trace_generation);
+  if (BXR_LIKELY(trace_local != NULL && trace_local_generation == generation))
+    return trace_local;
+  bxr_mutex_lock(&trace_mutex);
+  trace_buffer *b = NULL;
+  if (trace_file != NULL) b = malloc(sizeof(trace_buffer));
+  if (b != NULL) {
+    b->thread = trace_threads++;
+    b->len = 0;
+    b->next = trace_buffers;
+    trace_buffers = b;
+  }
+  trace_local = b;
+  trace_local_generation = generation;
+  bxr_mutex_unlock(&trace_mutex);
+  return b;
+}
+
+static void trace_record(int op, boxroot root, int flags)
+{
+  if (trace_muted) return;
+  trace_buffer *b = get_trace_buffer();
+  if (b == NULL) return;
+  struct boxroot_trace_record *r = &b->records[b->len++];
+  r->seq = atomic_fetch_add_explicit(&trace_seq, 1, memory_order_relaxed);
+  r->root = (uintptr_t)root;
+  r->thread = b->thread;
+  r->domain = (int16_t)bxr_cached_dom_id;
+  r->op = (uint8_t)op;
+  r->flags = (uint8_t)flags;
+  if (b->len == TRACE_BUFFER_RECORDS) {
+    bxr_mutex_lock(&trace_mutex);
+    write_trace_buffer(b);
+    bxr_mutex_unlock(&trace_mutex);
+  }
+}
+
+/* ownership required: the value */
+static int trace_value_kind(value v)
+{
+  if (!Is_block(v)) return BOXROOT_TRACE_IMMEDIATE;
+  return Is_young(v) ? BOXROOT_TRACE_YOUNG : BOXROOT_TRACE_OLD;
+}
+
+/* Called from the fast paths. `v` is ignored for deletions. */
+/* ownership required: root */
+void bxr_trace(int op, boxroot root, value v)
+{
+  int flags;
+  if (op == BOXROOT_TRACE_DELETE)
+    flags = get_pool_header(&root->contents)->free_list.class == YOUNG;
+  else
+    flags = trace_value_kind(v);
+  trace_record(op, root, flags);
+}
+
+bool boxroot_trace_start(const char *path)
+{
+  if (!BOXROOT_TRACE) return false;
+  bool res = false;
+  bxr_mutex_lock(&trace_mutex);
+  if (trace_file != NULL) goto out;
+  trace_file = fopen(path, "wb");
+  if (trace_file == NULL) goto out;
+  struct boxroot_trace_header h = {
+    .magic = BOXROOT_TRACE_MAGIC,
+    .version = BOXROOT_TRACE_VERSION,
+    .record_size = sizeof(struct boxroot_trace_record),
+  };
+  fwrite(&h, sizeof(h), 1, trace_file);
+  trace_threads = 0;
+  store_relaxed(&trace_seq, 0);
+  incr(&trace_generation);
+  bxr_tracing = true;
+  res = true;
+ out:
+  bxr_mutex_unlock(&trace_mutex);
+  return res;
+}
+
+void boxroot_trace_stop(void)
+{
+  bxr_mutex_lock(&trace_mutex);
+  bxr_tracing = false;
+  while (trace_buffers != NULL) {
+    trace_buffer *b = trace_buffers;
+    trace_buffers = b->next;
+    write_trace_buffer(b);
+    free(b);
+  }
+  if (trace_file != NULL) fclose(trace_file);
+  trace_file = NULL;
+  /* Forget the buffers of all threads */
+  incr(&trace_generation);
+  bxr_mutex_unlock(&trace_mutex);
+}
+
+/* }}} */
+
 /* {{{ Allocation, deallocation */
 
 /* Thread-safety: see documented constraints on the use of
@@ -545,6 +1684,7 @@ int boxroot_status()
 static bool setup();
 
 static void try_gc_and_reclassify_one_pool_no_stw(pool **source, int dom_id);
+static void flush_remote_bufs();
 
 // Set an available pool as current and allocate from it.
 /* ownership required: current domain */
@@ -565,7 +1705,7 @@ boxroot bxr_create_slow(value init)
   /* Initialize pool rings on this domain */
   if (pools[dom_id] == NULL) init_pool_rings(dom_id);
   pool_rings *local = pools[dom_id];
-  if (local == NULL) return NULL; /* ENOMEM */
+  if (local->node < 0) register_domain_node(local);
   /* Initialization successful, now cache domain_id on this thread if
      not done. */
   if (bxr_cached_dom_id == -1) {
@@ -579,6 +1719,31 @@ boxroot bxr_create_slow(value init)
        0). This exception is always enabled for future-proofing. */
     assert(bxr_cached_dom_id == dom_id);
   }
+  /* Bound the time for which deleted roots stay buffered */
+  if (OCAML_MULTICORE) flush_remote_bufs();
+  flush_events();
+  if (BXR_UNLIKELY(sampling_pending(dom_id))) {
+    domain_state *state = get_domain_state(dom_id);
+    bool expired = state->sample_countdown <= 0;
+    bool due = expired && state->sampling_rate != 0;
+    /* Allocate without counting down. The rate is taken into account
+       before retrying, otherwise the retry would come back here
+       whenever it takes the slow path. */
+    state->sampling_rate = load_relaxed(&sampling_rate);
+    set_countdown(state, LONG_MAX);
+    /* The attempt that ran the countdown out did not allocate */
+    if (expired) state->creations--;
+    boxroot r = boxroot_create(init);
+    if (due && r != NULL) record_sample(r);
+    restart_countdown(state);
+    return r;
+  }
+  if (local->current != NULL
+      && local->current->bump < POOL_CAPACITY) {
+    /* The free list is empty, but fresh slots remain */
+    carve_slots(local->current);
+    return boxroot_create(init);
+  }
   if (local->current != NULL) {
     /* Necessarily we are here because the pool is full */
     DEBUGassert(is_full_pool(local->current));
@@ -624,6 +1789,59 @@ void bxr_create_debug(value init)
 
 extern inline boxroot boxroot_create(value init);
 
+/* ownership required: current domain */
+bool boxroot_create_n(const value *vs, size_t n, boxroot *out)
+{
+  size_t i = 0;
+  while (i < n) {
+    /* Same checks as boxroot_create, but once per run of slots. */
+    ptrdiff_t dom_id = OCAML_MULTICORE ? bxr_cached_dom_id : 0;
+    bxr_free_list *fl = bxr_domain_states[dom_id + 1].current_free_list;
+    bxr_slot_ref s = fl->next;
+    if (BXR_LIKELY(!BXR_MULTITHREAD || bxr_domain_lock_held())
+        && BXR_LIKELY(s != (bxr_slot_ref)fl)) {
+      size_t run_start = i;
+      do {
+        if (BOXROOT_DEBUG) bxr_create_debug(vs[i]);
+        bxr_slot_ref next = s->as_slot_ref;
+        s->as_value = vs[i];
+        out[i++] = (boxroot)s;
+        s = next;
+      } while (i < n && s != (bxr_slot_ref)fl);
+      fl->next = s;
+      fl->alloc_count += (int)(i - run_start);
+      if (BOXROOT_TRACE && BXR_UNLIKELY(bxr_tracing)) {
+        for (size_t j = run_start; j < i; j++)
+          bxr_trace(BOXROOT_TRACE_CREATE, out[j], vs[j]);
+      }
+      domain_state *state = get_domain_state(dom_id);
+      state->sample_countdown -= (long)(i - run_start);
+      /* One sample per period that ran out during the run */
+      while (BXR_UNLIKELY(state->sample_countdown <= 0)) {
+        /* The roots created after the one that ran the countdown out */
+        long past = -state->sample_countdown;
+        DEBUGassert(past < (long)(i - run_start));
+        if (state->sampling_rate != 0) record_sample(out[i - 1 - past]);
+        restart_countdown(state);
+        if (state->sample_countdown == LONG_MAX) break;
+        /* They count towards the next period, and have already been
+           folded into `creations`. */
+        set_countdown(state, state->sample_countdown - past);
+      }
+      if (i == n) break;
+    }
+    /* The current pool ran out, or the domain is not initialised, or
+       we do not hold the domain lock. */
+    boxroot r = bxr_create_slow(vs[i]);
+    if (BXR_UNLIKELY(r == NULL)) {
+      boxroot_delete_n(out, i);
+      return false;
+    }
+    out[i++] = r;
+  }
+  return true;
+}
+
 /* Needed to avoid linking error with Rust */
 extern inline bool bxr_free_slot(bxr_free_list *fl, boxroot root);
 
@@ -636,24 +1854,207 @@ void bxr_delete_debug(boxroot root)
   else STATS_INCR(total_delete_old);
 }
 
-/* ownership required: root, any domain */
-static void free_slot_atomic(pool *p, boxroot root)
+/* Push the roots `rs[0..count)`, which belong to `p`, onto the
+   delayed free list of `p`. */
+/* ownership required: roots, any domain or lock-less deleter */
+static void free_slots_atomic(pool *p, boxroot *rs, int count)
 {
   /* We have a domain lock, but not from the same domain as the pool.
      We perform a lock-free remote deallocation */
   /* Hey how do you avoid a CAS and the ABA problem? Well I only flush
      the delayed free list during stop-the-world sections or when the
      pool is empty! */
-  bxr_slot_ref new_next = &root->contents;
-  bxr_slot_ref old_next = atomic_exchange_explicit(&p->delayed_fl.a_next, new_next,
+  for (int i = 0; i < count - 1; i++)
+    rs[i]->contents.as_slot_ref = &rs[i + 1]->contents;
+  bxr_slot_ref first = &rs[0]->contents;
+  bxr_slot_ref last = &rs[count - 1]->contents;
+  bxr_slot_ref old_next = atomic_exchange_explicit(&p->delayed_fl.a_next, first,
                                                memory_order_relaxed);
-  new_next->as_slot_ref = old_next;
+  last->as_slot_ref = old_next;
   if (BXR_UNLIKELY(is_empty_free_list(old_next, p)))
-    p->delayed_fl.end = new_next;
+    p->delayed_fl.end = last;
   /* memory_order_release is needed here for flushing outside of STW
      sections (when the pool is empty). Otherwise memory_order_relaxed
      is enough. */
-  decr_release(&p->delayed_fl.a_alloc_count);
+  sub_release(&p->delayed_fl.a_alloc_count, count);
+}
+
+/* Deallocation without holding any domain lock. The only concurrent
+   accesses to fear come from the GC during STW sections. The deleter
+   announces itself in `p->lockless_deleters` and then checks that no
+   STW section is accessing the pools, while a scanning domain
+   announces itself in `scanning_domains` and then waits for the
+   lock-less deleters of each pool it accesses (`quiesce_pool`).
+   Thanks to sequential consistency, at least one of the two sees the
+   other, and the deleter backs off until the STW section is over.
+
+   The same argument applies to `lockless_deletion_seen` and to
+   `boundary_flushers`, set before the deleter announces itself: if a
+   scanning domain sees neither after announcing itself, then the
+   deleter sees the scanning domain. */
+/* Returns false, without deallocating, if a STW section is
+   accessing the pools. */
+/* ownership required: roots */
+static bool try_free_slots_lockless(pool *p, boxroot *rs, int count)
+{
+  atomic_fetch_add(&p->lockless_deleters, 1);
+  if (BXR_UNLIKELY(atomic_load(&scanning_domains) != 0)) {
+    decr(&p->lockless_deleters);
+    return false;
+  }
+  free_slots_atomic(p, rs, count);
+  /* Release: publish the deallocation to quiesce_pool. */
+  decr_release(&p->lockless_deleters);
+  return true;
+}
+
+/* ownership required: roots */
+static void free_slots_lockless(pool *p, boxroot *rs, int count)
+{
+  STATS_INCR(total_delete_lockless);
+  if (BXR_UNLIKELY(!load_relaxed(&lockless_deletion_seen)))
+    atomic_store(&lockless_deletion_seen, true);
+  while (!try_free_slots_lockless(p, rs, count)) {
+    STATS_INCR(total_lockless_backoffs);
+    while (load_relaxed(&scanning_domains) != 0) bxr_yield();
+  }
+}
+
+/* ownership required: roots */
+static void free_slots_remote(pool *p, boxroot *rs, int count)
+{
+  if (OCAML_MULTICORE && bxr_domain_lock_held()) {
+    /* Remote, from another domain */
+    free_slots_atomic(p, rs, count);
+  } else {
+    /* No domain lock held */
+    free_slots_lockless(p, rs, count);
+  }
+}
+
+/* Remote deallocations performed while holding a domain lock are
+   buffered per thread and per pool, and each buffer is published to
+   the delayed free list of its pool with a single atomic exchange.
+   This avoids bouncing the cache line of `delayed_fl` between the
+   deallocating domain and the owning domain at every deallocation.
+
+   Until it is published, a buffered slot keeps its value and is
+   still counted as allocated: it is scanned like a live root. This
+   delays the release of the value until the buffer is flushed, but
+   keeps the pool consistent for the GC without further
+   synchronisation. During STW sections, where the owning domain can
+   be emptying the delayed free lists concurrently, buffers are only
+   flushed with the lock-less protocol, outside of the scans of the
+   pools.
+
+   Buffers are flushed:
+   - when full, or when evicted by a deallocation to another pool;
+   - when the thread takes the slow path of creation or of local
+     deallocation;
+   - when the thread takes part in a collection, before and after its
+     domain scans its pools, unless another domain is scanning its
+     own pools at that moment;
+   - when the thread enters a blocking section, when its domain
+     terminates, and when the thread exits.
+   Thus each thread retains at most REMOTE_BUF_POOLS *
+   REMOTE_BUF_SLOTS deleted roots. A thread running OCaml code
+   retains them until one of the above happens; a thread that is
+   descheduled without entering a blocking section (systhreads
+   switching on its tick) retains them until it runs again. */
+
+#define REMOTE_BUF_POOLS 4
+#define REMOTE_BUF_SLOTS 64
+
+typedef struct {
+  pool *pool;
+  int count;
+  boxroot slots[REMOTE_BUF_SLOTS];
+} remote_buf;
+
+static _Thread_local remote_buf remote_bufs[REMOTE_BUF_POOLS];
+static _Thread_local bool remote_bufs_registered = false;
+/* Its destructor flushes the buffers at thread exit */
+static thread_key_t remote_bufs_key;
+
+/* ownership required: buffer */
+static void flush_remote_buf(remote_buf *b)
+{
+  if (b->count == 0) return;
+  STATS_INCR(total_remote_flushes);
+  free_slots_remote(b->pool, b->slots, b->count);
+  b->pool = NULL;
+  b->count = 0;
+}
+
+/* ownership required: none */
+static void flush_remote_bufs()
+{
+  for (int i = 0; i < REMOTE_BUF_POOLS; i++)
+    flush_remote_buf(&remote_bufs[i]);
+}
+
+/* At the boundaries of a scan, when the owners of the pools may be
+   emptying their delayed free lists: give up on the remaining
+   buffers as soon as a domain is scanning its pools. Announced in
+   `boundary_flushers` rather than `lockless_deletion_seen`, so that
+   programs without lock-less deletions keep skipping
+   `quiesce_pool`. */
+/* ownership required: current domain, outside of the scanning of its
+   pools */
+static void try_flush_remote_bufs()
+{
+  bool announced = false;
+  for (int i = 0; i < REMOTE_BUF_POOLS; i++) {
+    remote_buf *b = &remote_bufs[i];
+    if (b->count == 0) continue;
+    if (!announced) {
+      atomic_fetch_add(&boundary_flushers, 1);
+      announced = true;
+    }
+    if (!try_free_slots_lockless(b->pool, b->slots, b->count)) break;
+    STATS_INCR(total_remote_flushes);
+    b->pool = NULL;
+    b->count = 0;
+  }
+  if (announced) atomic_fetch_sub(&boundary_flushers, 1);
+}
+
+/* At thread exit. No domain lock is held. */
+static void flush_remote_bufs_at_exit(void *bufs)
+{
+  /* The pools no longer exist after teardown. */
+  if (boxroot_status() != BOXROOT_RUNNING) return;
+  DEBUGassert(bufs == remote_bufs);
+  (void)bufs;
+  flush_remote_bufs();
+}
+
+/* ownership required: root, any domain */
+static void buffer_remote_slot(pool *p, boxroot root)
+{
+  remote_buf *b = NULL;
+  remote_buf *victim = &remote_bufs[0];
+  for (int i = 0; i < REMOTE_BUF_POOLS; i++) {
+    if (remote_bufs[i].pool == p) { b = &remote_bufs[i]; break; }
+    if (remote_bufs[i].count < victim->count) victim = &remote_bufs[i];
+  }
+  if (b == NULL) {
+    /* Evict the least filled buffer */
+    flush_remote_buf(victim);
+    if (BXR_UNLIKELY(!remote_bufs_registered)) {
+      remote_bufs_registered =
+        bxr_set_thread_key(remote_bufs_key, remote_bufs);
+      /* Without destructor, we could leak the slots at thread exit. */
+      if (!remote_bufs_registered) {
+        free_slots_remote(p, &root, 1);
+        return;
+      }
+    }
+    b = victim;
+    b->pool = p;
+  }
+  b->slots[b->count++] = root;
+  if (b->count == REMOTE_BUF_SLOTS) flush_remote_buf(b);
 }
 
 /* ownership required: root, current domain */
@@ -665,35 +2066,146 @@ void bxr_delete_slow(bxr_free_list *fl, boxroot root, bool remote)
     /* We own the domain lock. Deallocation already done, but we
        passed a deallocation threshold. */
     try_demote_pool(p->free_list.domain_id, p);
+    if (OCAML_MULTICORE) flush_remote_bufs();
   } else if (OCAML_MULTICORE && bxr_domain_lock_held()) {
     /* Remote, from another domain */
-    free_slot_atomic(p, root);
+    buffer_remote_slot(p, root);
   } else {
-    /* No domain lock held */
-    bxr_mutex_lock(&p->mutex);
-    free_slot_atomic(p, root);
-    bxr_mutex_unlock(&p->mutex);
+    free_slots_remote(p, &root, 1);
   }
 }
 
-extern inline void boxroot_delete(boxroot root);
+/* Push the roots `rs[0..count)`, which belong to `p`, onto the free
+   list of `p`, and return true iff a deallocation threshold has been
+   passed, as with as many calls to `bxr_free_slot`. */
+/* ownership required: roots, domain of the pool */
+static bool free_slots_local(pool *p, boxroot *rs, int count)
+{
+  bxr_free_list *fl = &p->free_list;
+  bxr_slot_ref next = fl->next;
+  if (BXR_MULTITHREAD && BXR_UNLIKELY(is_empty_free_list(next, p)))
+    fl->end = &rs[count - 1]->contents;
+  for (int i = count - 1; i >= 0; i--) {
+    rs[i]->contents.as_slot_ref = next;
+    next = &rs[i]->contents;
+  }
+  fl->next = next;
+  int old_count = fl->alloc_count;
+  int new_count = old_count - count;
+  fl->alloc_count = new_count;
+  /* Is there a multiple of the threshold in [new_count, old_count - 1]? */
+  return ((old_count - 1) & ~(BXR_DEALLOC_THRESHOLD - 1))
+    != ((new_count - 1) & ~(BXR_DEALLOC_THRESHOLD - 1));
+}
 
-/* ownership required: root, current domain */
-bool bxr_modify_slow(boxroot *root_ref, value new_value)
+/* Release [count] roots of [p] at once */
+/* ownership required: roots */
+static void delete_run(pool *p, boxroot *rs, int count, ptrdiff_t dom_id,
+                       bool lock_held)
 {
-  STATS_INCR(total_modify_slow);
-  boxroot root = *root_ref;
-  /* If the new value is not a young block, we can substitute. */
-  if (!Is_block(new_value) || !Is_young(new_value)) {
-    root->contents.as_value = new_value;
-    return true;
+  bool remote_dom_id =
+    OCAML_MULTICORE ? p->free_list.domain_id != dom_id : false;
+  bool remote =
+    BXR_FORCE_REMOTE
+    || (BXR_MULTITHREAD && (BXR_UNLIKELY(remote_dom_id) || !lock_held));
+  if (remote) {
+    STATS_INCR(total_delete_slow);
+    free_slots_remote(p, rs, count);
+  } else if (BXR_UNLIKELY(free_slots_local(p, rs, count))) {
+    /* One reclassification for the whole run */
+    STATS_INCR(total_delete_slow);
+    try_demote_pool(p->free_list.domain_id, p);
+  }
+}
+
+/* `boxroot_delete_n` groups the roots by pool within windows of
+   DELETE_WINDOW roots spanning at most DELETE_POOLS pools, so that
+   roots of a few pools interleaved in any order are released with
+   one free-list update per pool and window. */
+#define DELETE_WINDOW 64
+#define DELETE_POOLS 8
+
+/* ownership required: roots */
+void boxroot_delete_n(boxroot *rs, size_t n)
+{
+  ptrdiff_t dom_id = OCAML_MULTICORE ? bxr_cached_dom_id : 0;
+  bool lock_held = bxr_domain_lock_held();
+  if (BOXROOT_TRACE && BXR_UNLIKELY(bxr_tracing)) {
+    for (size_t j = 0; j < n; j++)
+      bxr_trace(BOXROOT_TRACE_DELETE, rs[j], 0);
+  }
+  size_t i = 0;
+  while (i < n) {
+    pool *ps[DELETE_POOLS];
+    int counts[DELETE_POOLS];
+    unsigned char which[DELETE_WINDOW];
+    int num_pools = 0;
+    size_t start = i;
+    /* Find the pool of each root of the window */
+    for (; i < n && i - start < DELETE_WINDOW; i++) {
+      pool *p = get_pool_header(&rs[i]->contents);
+      int k = 0;
+      while (k < num_pools && ps[k] != p) k++;
+      if (k == num_pools) {
+        if (num_pools == DELETE_POOLS) break;
+        ps[num_pools] = p;
+        counts[num_pools++] = 0;
+      }
+      if (BOXROOT_DEBUG) bxr_delete_debug(rs[i]);
+      if (BXR_UNLIKELY(p->free_list.sampled != 0))
+        bxr_forget_sample(&p->free_list, rs[i]);
+      which[i - start] = (unsigned char)k;
+      counts[k]++;
+    }
+    if (num_pools == 1) {
+      delete_run(ps[0], &rs[start], counts[0], dom_id, lock_held);
+      continue;
+    }
+    /* Sort the window by pool, counting */
+    boxroot grouped[DELETE_WINDOW];
+    int offsets[DELETE_POOLS];
+    for (int k = 0, off = 0; k < num_pools; k++) {
+      offsets[k] = off;
+      off += counts[k];
+    }
+    for (size_t j = start; j < i; j++)
+      grouped[offsets[which[j - start]]++] = rs[j];
+    for (int k = 0, off = 0; k < num_pools; k++) {
+      delete_run(ps[k], &grouped[off], counts[k], dom_id, lock_held);
+      off += counts[k];
+    }
+  }
+}
+
+extern inline void boxroot_delete(boxroot root);
+
+/* ownership required: root, current domain */
+bool bxr_modify_slow(boxroot *root_ref, value new_value)
+{
+  STATS_INCR(total_modify_slow);
+  boxroot root = *root_ref;
+  /* If the new value is not a young block, we can substitute. */
+  if (!Is_block(new_value) || !Is_young(new_value)) {
+    root->contents.as_value = new_value;
+    if (BOXROOT_TRACE && BXR_UNLIKELY(bxr_tracing))
+      bxr_trace(BOXROOT_TRACE_MODIFY, root, new_value);
+    return true;
   }
   /* Else, the pool is old and the value is young, so we need to
      reallocate */
+  trace_muted = true;
   boxroot new = boxroot_create(new_value);
-  if (BXR_UNLIKELY(new == NULL)) return false;
+  if (BXR_UNLIKELY(new == NULL)) {
+    trace_muted = false;
+    return false;
+  }
   *root_ref = new;
   boxroot_delete(root);
+  trace_muted = false;
+  if (BOXROOT_TRACE && BXR_UNLIKELY(bxr_tracing)) {
+    bxr_trace(BOXROOT_TRACE_MODIFY, root, new_value);
+    trace_record(BOXROOT_TRACE_MOVE, new, 0);
+  }
   return true;
 }
 
@@ -712,6 +2224,7 @@ extern inline bool boxroot_modify(boxroot *rootp, value new_value);
 /* ownership required: pool */
 static void validate_pool(pool *pl)
 {
+  quiesce_pool(pl);
   if (pl->free_list.next == NULL) {
     // an unintialised pool
     assert(pl->free_list.class == UNTRACKED);
@@ -722,13 +2235,13 @@ static void validate_pool(pool *pl)
   int pos = 0;
   for (; !is_empty_free_list(curr, pl); curr = curr->as_slot_ref, pos++)
   {
-    assert(pos < POOL_CAPACITY);
-    assert(curr >= pl->roots && curr < pl->roots + POOL_CAPACITY);
+    assert(pos < pl->bump);
+    assert(curr >= pl->roots && curr < pl->roots + pl->bump);
   }
-  assert(pos == POOL_CAPACITY - pl->free_list.alloc_count);
+  assert(pos == pl->bump - pl->free_list.alloc_count);
   // check count of allocated elements
   int count = 0;
-  for(int i = 0; i < POOL_CAPACITY; i++) {
+  for(int i = 0; i < pl->bump; i++) {
     bxr_slot s = pl->roots[i];
     STATS_DECR(is_pool_member);
     if (!is_pool_member(s, pl)) {
@@ -758,6 +2271,27 @@ static void validate_ring(pool **ring, int dom_id, int cl)
   } while (p != start_pool);
 }
 
+/* ownership required: domain */
+static void validate_dir(pool_dir *dir, pool **ring)
+{
+  int len = 0;
+  pool *start_pool = *ring;
+  if (start_pool != NULL) {
+    pool *p = start_pool;
+    do {
+      if (dir->failed) {
+        assert(p->dir_index == -1);
+      } else {
+        assert(p->dir_index >= 0 && p->dir_index < dir->len);
+        assert(dir->pools[p->dir_index] == p);
+      }
+      len++;
+      p = p->next;
+    } while (p != start_pool);
+  }
+  assert(dir->failed ? dir->len == 0 : dir->len == len);
+}
+
 static void validate_current_pool(pool **current, int dom_id)
 {
   if (*current != NULL) (*current)->free_list.alloc_count--;
@@ -771,12 +2305,27 @@ static void validate_all_pools(int dom_id)
   pool_rings *local = pools[dom_id];
   validate_ring(&local->old, dom_id, OLD);
   validate_ring(&local->young, dom_id, YOUNG);
+  validate_dir(&local->old_dir, &local->old);
+  validate_dir(&local->young_dir, &local->young);
   validate_current_pool(&local->current, dom_id);
   validate_ring(&local->free, dom_id, UNTRACKED);
+  validate_ring(&local->decommitted, dom_id, UNTRACKED);
 }
 
 static void gc_pool_rings(int dom_id);
 
+/* Move the pools of [*ring] to the rings of class [cl] of orphans,
+   according to their node. */
+/* ownership required: ring, orphan_mutex */
+static void orphan_ring(pool **ring, int cl)
+{
+  while (*ring != NULL) {
+    pool *p = ring_pop(ring);
+    pool_rings *target = &orphan[p->node];
+    ring_push_back(p, (cl == OLD) ? &target->old : &target->young);
+  }
+}
+
 /* ownership required: STW */
 static void orphan_pools(int dom_id)
 {
@@ -784,23 +2333,42 @@ static void orphan_pools(int dom_id)
   if (local == NULL) return;
   move_current_to_young(dom_id);
   gc_pool_rings(dom_id);
+  release_dir(&local->old_dir);
+  release_dir(&local->young_dir);
+  rebase_ring(local->old, dom_id, -1);
+  rebase_ring(local->young, dom_id, -1);
   bxr_mutex_lock(&orphan_mutex);
-  /* Move active pools to the orphaned pools. TODO: NUMA awareness? */
-  ring_push_back(local->old, &orphan.old);
-  ring_push_back(local->young, &orphan.young);
+  /* Move active pools to the orphaned pools. */
+  orphan_ring(&local->old, OLD);
+  orphan_ring(&local->young, YOUNG);
   bxr_mutex_unlock(&orphan_mutex);
+  if (local->node >= 0) decr(&domains_on_node[local->node]);
   /* Free the rest */
   free_pool_ring(&local->free);
+  free_decommitted_ring(&local->decommitted);
+  if (STATS) {
+    DOMAIN_STATS(dom_id).free_pools_target -= local->free_target;
+    /* Counted again by the adopting domain */
+    store_relaxed(&DOMAIN_STATS(dom_id).sparse_pools, 0);
+  }
   /* Reset local pools for later domains spawning with the same id */
   init_pool_rings(dom_id);
 }
 
+/* Adopt the orphans of our node, and those of the nodes that have no
+   live domain left (there must be no pool left unscanned). */
 /* ownership required: domain */
 static void adopt_orphaned_pools(int dom_id)
 {
+  int own = pools[dom_id]->node;
   bxr_mutex_lock(&orphan_mutex);
-  reclassify_ring(&orphan.old, dom_id, OLD);
-  reclassify_ring(&orphan.young, dom_id, YOUNG);
+  for (int n = 0; n < BXR_MAX_NUMA_NODES; n++) {
+    if (n != own && load_relaxed(&domains_on_node[n]) != 0) continue;
+    rebase_ring(orphan[n].old, dom_id, 1);
+    rebase_ring(orphan[n].young, dom_id, 1);
+    reclassify_ring(&orphan[n].old, dom_id, OLD);
+    reclassify_ring(&orphan[n].young, dom_id, YOUNG);
+  }
   bxr_mutex_unlock(&orphan_mutex);
 }
 
@@ -882,15 +2450,19 @@ static void gc_pool_rings(int dom_id)
   gc_ring(&local->old, dom_id);
 }
 
-// returns the amount of work done
-/* ownership required: STW, pool mutex */
-static int scan_pool_gen(scanning_action action, void *data, pool *pl)
+/* Selected at setup according to the CPU. */
+static bool use_avx2 = false;
+
+/* Scan the next [allocs_to_find] live slots from [current], return
+   the end of the scanned range. */
+/* ownership required: STW, quiescent pool */
+static bxr_slot_ref scan_gen_scalar(scanning_action action, void *data,
+                                    pool *pl, bxr_slot_ref current,
+                                    int allocs_to_find)
 {
-  int allocs_to_find = anticipated_alloc_count(pl);
   int young_hit = 0;
-  bxr_slot_ref current = pl->roots;
   while (allocs_to_find) {
-    DEBUGassert(current < &pl->roots[POOL_CAPACITY]);
+    DEBUGassert(current < &pl->roots[pl->bump]);
     // hot path
     bxr_slot s = *current;
     if (!is_pool_member(s, pl)) {
@@ -901,19 +2473,183 @@ static int scan_pool_gen(scanning_action action, void *data, pool *pl)
     }
     ++current;
   }
-  if (STATS) stats.young_hit_gen += young_hit;
-  return current - pl->roots;
+  if (STATS) LOCAL_STATS.young_hit_gen += young_hit;
+  return current;
 }
 
+#if BXR_SIMD_AVX2
+
+/* Bitmask of the lanes of [m] that are all zeroes, for [m] whose
+   lanes are all zeroes or all ones. */
+__attribute__((target("avx2")))
+static inline unsigned zero_lanes_avx2(__m256i m)
+{
+  return ~(unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(m)) & 0xF;
+}
+
+/* Bitmask of the four slots in [v] that do not hold immediates.
+   `zero_lanes_avx2` only looks at the top bit of each lane, so the
+   tag bit is first spread to the whole lane. */
+__attribute__((target("avx2")))
+static inline unsigned block_mask_avx2(__m256i v, __m256i one)
+{
+  return zero_lanes_avx2(_mm256_cmpeq_epi64(_mm256_and_si256(v, one), one));
+}
+
+/* Bitmask of the four slots in [v] that are live, i.e. that are not
+   members of the pool; see [is_pool_member]. */
+__attribute__((target("avx2")))
+static inline unsigned live_mask_avx2(__m256i v, __m256i member_mask,
+                                      __m256i pool)
+{
+  return zero_lanes_avx2(
+    _mm256_cmpeq_epi64(_mm256_and_si256(v, member_mask), pool));
+}
+
+/* Same as [scan_gen_scalar] from the start of the pool, eight slots
+   at a time. The GC action is only called on live blocks: the
+   immediates need no scanning. Stops at the last live slot, like the
+   scalar version, and at the high-water mark. */
+/* ownership required: STW, quiescent pool */
+__attribute__((target("avx2")))
+static bxr_slot_ref scan_gen_avx2(scanning_action action, void *data,
+                                  pool *pl, int allocs_to_find)
+{
+  const __m256i member_mask =
+    _mm256_set1_epi64x((long long)~((uintptr_t)BXR_POOL_SIZE - 2));
+  const __m256i pool_v = _mm256_set1_epi64x((long long)(uintptr_t)pl);
+  const __m256i one = _mm256_set1_epi64x(1);
+  bxr_slot_ref current = pl->roots;
+  bxr_slot_ref end = pl->roots + pl->bump;
+  int young_hit = 0;
+  while (allocs_to_find && end - current >= 8) {
+    __m256i lo = _mm256_loadu_si256((const __m256i *)current);
+    __m256i hi = _mm256_loadu_si256((const __m256i *)(current + 4));
+    unsigned live = live_mask_avx2(lo, member_mask, pool_v)
+      | live_mask_avx2(hi, member_mask, pool_v) << 4;
+    unsigned blocks = live
+      & (block_mask_avx2(lo, one) | block_mask_avx2(hi, one) << 4);
+    int found = __builtin_popcount(live);
+    DEBUGassert(found <= allocs_to_find);
+    while (blocks != 0) {
+      int i = __builtin_ctz(blocks);
+      blocks &= blocks - 1;
+      value v = current[i].as_value;
+      if (BOXROOT_DEBUG && Is_young(v)) ++young_hit;
+      CALL_GC_ACTION(action, data, v, &current[i].as_value);
+    }
+    if (found >= allocs_to_find) {
+      /* Count the work up to the last live slot */
+      current += 32 - __builtin_clz(live);
+      allocs_to_find = 0;
+      break;
+    }
+    allocs_to_find -= found;
+    current += 8;
+  }
+  if (STATS) LOCAL_STATS.young_hit_gen += young_hit;
+  return scan_gen_scalar(action, data, pl, current, allocs_to_find);
+}
+
+#endif // BXR_SIMD_AVX2
+
+// returns the amount of work done
+/* ownership required: STW, quiescent pool */
+static int scan_pool_gen(scanning_action action, void *data, pool *pl)
+{
+  int allocs_to_find = anticipated_alloc_count(pl);
+  bxr_slot_ref end;
+#if BXR_SIMD_AVX2
+  if (use_avx2)
+    end = scan_gen_avx2(action, data, pl, allocs_to_find);
+  else
+#endif
+    end = scan_gen_scalar(action, data, pl, pl->roots, allocs_to_find);
+  return end - pl->roots;
+}
+
+/* Scan the slots in [start, end) holding young blocks, return the
+   number of young hits. */
+/* ownership required: STW, quiescent pool */
+static int scan_young_scalar(scanning_action action, void *data,
+                             bxr_slot_ref start, bxr_slot_ref end,
+                             uintnat young_start, uintnat young_range)
+{
+  int young_hit = 0;
+  bxr_slot_ref current;
+  for (current = start; current < end; current++) {
+    bxr_slot s = *current;
+    value v = s.as_value;
+    /* Optimise for branch prediction: if v falls within the young
+       range, then it is likely that it is a block */
+    if ((uintnat)v - young_start <= young_range
+        && BXR_LIKELY(Is_block(v))) {
+      ++young_hit;
+      CALL_GC_ACTION(action, data, v, &current->as_value);
+    }
+  }
+  return young_hit;
+}
+
+#if BXR_SIMD_AVX2
+
+/* Bitmask of the four slots in [v] that hold young blocks. AVX2 has
+   no unsigned 64-bit comparison, so the range test flips the sign
+   bits and compares signed. */
+__attribute__((target("avx2")))
+static inline unsigned young_mask_avx2(__m256i v, __m256i start,
+                                       __m256i limit, __m256i sign,
+                                       __m256i one)
+{
+  __m256i offset = _mm256_xor_si256(_mm256_sub_epi64(v, start), sign);
+  __m256i outside = _mm256_cmpgt_epi64(offset, limit);
+  return zero_lanes_avx2(outside) & block_mask_avx2(v, one);
+}
+
+/* Same as [scan_young_scalar], eight slots at a time. The GC action
+   is only called on the set bits of the mask, so misses cost neither
+   a branch nor a call. */
+/* ownership required: STW, quiescent pool */
+__attribute__((target("avx2")))
+static int scan_young_avx2(scanning_action action, void *data,
+                           bxr_slot_ref start, bxr_slot_ref end,
+                           uintnat young_start, uintnat young_range)
+{
+  const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+  const __m256i vstart = _mm256_set1_epi64x((long long)young_start);
+  const __m256i limit =
+    _mm256_set1_epi64x((long long)(young_range ^ (uintnat)INT64_MIN));
+  const __m256i one = _mm256_set1_epi64x(1);
+  int young_hit = 0;
+  bxr_slot_ref current = start;
+  for (; end - current >= 8; current += 8) {
+    __m256i lo = _mm256_loadu_si256((const __m256i *)current);
+    __m256i hi = _mm256_loadu_si256((const __m256i *)(current + 4));
+    unsigned mask = young_mask_avx2(lo, vstart, limit, sign, one)
+      | young_mask_avx2(hi, vstart, limit, sign, one) << 4;
+    while (mask != 0) {
+      int i = __builtin_ctz(mask);
+      mask &= mask - 1;
+      ++young_hit;
+      CALL_GC_ACTION(action, data, current[i].as_value,
+                     &current[i].as_value);
+    }
+  }
+  return young_hit + scan_young_scalar(action, data, current, end,
+                                       young_start, young_range);
+}
+
+#endif // BXR_SIMD_AVX2
+
 /* Specialised version of [scan_pool_gen] when [only_young].
 
-   Benchmark results for minor scanning:
+   Benchmark results for minor scanning (scalar kernel):
    20% faster for young hits=95%
    20% faster for young hits=50% (random)
    90% faster for young_hit=10% (random)
    280% faster for young hits=0%
 */
-/* ownership required: STW, pool mutex */
+/* ownership required: STW, quiescent pool */
 static int scan_pool_young(scanning_action action, void *data, pool *pl)
 {
 #if OCAML_MULTICORE
@@ -927,33 +2663,152 @@ static int scan_pool_young(scanning_action action, void *data, pool *pl)
   uintnat young_range = (uintnat)Caml_state->young_end - young_start;
 #endif
   bxr_slot_ref start = pl->roots;
-  bxr_slot_ref end = start + POOL_CAPACITY;
-  int young_hit = 0;
-  bxr_slot_ref current;
-  for (current = start; current < end; current++) {
-    bxr_slot s = *current;
-    value v = s.as_value;
-    /* Optimise for branch prediction: if v falls within the young
-       range, then it is likely that it is a block */
-    if ((uintnat)v - young_start <= young_range
-        && BXR_LIKELY(Is_block(v))) {
-      ++young_hit;
-      CALL_GC_ACTION(action, data, v, &current->as_value);
+  /* Stop at the high-water mark: the slots beyond have not been
+     allocated (and are not initialised). */
+  bxr_slot_ref end = start + pl->bump;
+  if (STATS)
+    DOMAIN_STATS(Domain_id).young_slots_skipped += POOL_CAPACITY - pl->bump;
+  int young_hit;
+#if BXR_SIMD_AVX2
+  if (use_avx2)
+    young_hit = scan_young_avx2(action, data, start, end,
+                                young_start, young_range);
+  else
+#endif
+    young_hit = scan_young_scalar(action, data, start, end,
+                                  young_start, young_range);
+  if (STATS) DOMAIN_STATS(Domain_id).young_hit_young += young_hit;
+  return end - start;
+}
+
+/* {{{ Self-check of the scanning kernels */
+
+/* Compare the SIMD scanning kernels with the scalar ones on a pool
+   holding free slots, immediates (some of them inside the young
+   range), and blocks inside and outside of the young range. Returns
+   false if they disagree. Does not need boxroot to be set up. Used
+   by tests/scan_kernels.ml. */
+
+/* Not a multiple of 8, so that the scalar tails are exercised */
+#define CHECK_SLOTS 203
+
+typedef struct {
+  int len;
+  value *slots[CHECK_SLOTS];
+} kernel_calls;
+
+/* The calls recorded by [record_call] */
+static kernel_calls *check_calls = NULL;
+
+#if OCAML_MULTICORE
+static void record_call(void *data, value v, value *p)
+{
+  (void)data; (void)v;
+  check_calls->slots[check_calls->len++] = p;
+}
+#else
+static void record_call(value v, value *p)
+{
+  (void)v;
+  check_calls->slots[check_calls->len++] = p;
+}
+#endif
+
+/* Forget the calls on immediates */
+static void keep_blocks(kernel_calls *c)
+{
+  int len = 0;
+  for (int i = 0; i < c->len; i++)
+    if (Is_block(*c->slots[i])) c->slots[len++] = c->slots[i];
+  c->len = len;
+}
+
+static bool same_calls(kernel_calls *a, kernel_calls *b)
+{
+  if (a->len != b->len) return false;
+  for (int i = 0; i < a->len; i++)
+    if (a->slots[i] != b->slots[i]) return false;
+  return true;
+}
+
+bool bxr_check_scan_kernels(void)
+{
+#if BXR_SIMD_AVX2
+  if (!bxr_cpu_has_avx2()) return true;
+  static_assert(CHECK_SLOTS <= POOL_CAPACITY, "pool too small");
+  /* A fake minor heap, and blocks outside of it */
+  static value young[64], old[64];
+  uintnat young_start = (uintnat)young;
+  uintnat young_range = sizeof(young) - 1;
+  static kernel_calls scalar, simd;
+  pool *p = bxr_alloc_uninitialised_pool(BXR_POOL_SIZE);
+  if (p == NULL) return false;
+  init_pool(p);
+  p->bump = CHECK_SLOTS;
+  int live = 0;
+  uint32_t x = 2463534242u;
+  for (int i = 0; i < CHECK_SLOTS; i++) {
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    value v;
+    switch (x % 6) {
+    case 0: v = (value)&p->roots[x % CHECK_SLOTS]; break; /* free */
+    case 1: v = Val_long(i); break;
+    case 2: v = (value)&young[i % 64] | 1; break; /* odd, in range */
+    case 3: v = (value)&young[i % 64]; break;
+    case 4: v = (value)&old[i % 64]; break;
+    default: v = (value)&old[i % 64] | 1; break;
     }
+    p->roots[i].as_value = v;
+    if (!is_pool_member(p->roots[i], p)) live++;
   }
-  if (STATS) stats.young_hit_young += young_hit;
-  return current - start;
+  p->free_list.alloc_count = live;
+  bool ok = true;
+  /* Young scanning */
+  scalar.len = simd.len = 0;
+  check_calls = &scalar;
+  int scalar_hits = scan_young_scalar(&record_call, NULL, p->roots,
+                                      p->roots + CHECK_SLOTS,
+                                      young_start, young_range);
+  check_calls = &simd;
+  int simd_hits = scan_young_avx2(&record_call, NULL, p->roots,
+                                  p->roots + CHECK_SLOTS,
+                                  young_start, young_range);
+  ok = ok && scalar_hits == simd_hits && same_calls(&scalar, &simd);
+  /* Generic scanning: the scalar kernel also calls the action on
+     immediates, the SIMD kernel only in its scalar tail. */
+  scalar.len = simd.len = 0;
+  check_calls = &scalar;
+  bxr_slot_ref scalar_end = scan_gen_scalar(&record_call, NULL, p,
+                                            p->roots, live);
+  check_calls = &simd;
+  bxr_slot_ref simd_end = scan_gen_avx2(&record_call, NULL, p, live);
+  for (int i = 0; i < simd.len; i++) {
+    if (Is_long(*simd.slots[i])
+        && simd.slots[i] < &p->roots[CHECK_SLOTS / 8 * 8].as_value)
+      ok = false;
+  }
+  keep_blocks(&scalar);
+  keep_blocks(&simd);
+  ok = ok && scalar_end == simd_end && same_calls(&scalar, &simd);
+  check_calls = NULL;
+  bxr_free_pool(p);
+  return ok;
+#else
+  return true;
+#endif
 }
 
+/* }}} */
+
 /* ownership required: STW */
 static int scan_pool(scanning_action action, int only_young, void *data,
                      pool *pl)
 {
-  bxr_mutex_lock(&pl->mutex);
-  int work = (only_young) ? scan_pool_young(action, data, pl)
-                          : scan_pool_gen(action, data, pl);
-  bxr_mutex_unlock(&pl->mutex);
-  return work;
+  /* Usually a no-op since gc_pool already did it, except for adopted
+     pools. */
+  quiesce_pool(pl);
+  return (only_young) ? scan_pool_young(action, data, pl)
+                      : scan_pool_gen(action, data, pl);
 }
 
 /* ownership required: STW */
@@ -971,13 +2826,267 @@ static int scan_ring(scanning_action action, int only_young,
   return work;
 }
 
+/* How many pools ahead to prefetch when scanning a directory */
+#define SCAN_PREFETCH_DISTANCE 4
+
+/* ownership required: STW */
+static int scan_pool_array(scanning_action action, int only_young,
+                           void *data, pool **ps, int len)
+{
+  int work = 0;
+  for (int i = 0; i < len; i++) {
+    if (i + SCAN_PREFETCH_DISTANCE < len) {
+      pool *ahead = ps[i + SCAN_PREFETCH_DISTANCE];
+      /* The header, the line of `lockless_deleters`, and the first
+         slots */
+      bxr_prefetch(ahead);
+      bxr_prefetch(&ahead->delayed_fl);
+      bxr_prefetch(&ahead->roots[0]);
+      bxr_prefetch(&ahead->roots[Cache_line_size / sizeof(bxr_slot)]);
+    }
+    work += scan_pool(action, only_young, data, ps[i]);
+  }
+  return work;
+}
+
+/* ownership required: STW */
+static int scan_dir(scanning_action action, int only_young,
+                    void *data, pool_dir *dir, pool **ring)
+{
+  if (dir->failed) return scan_ring(action, only_young, data, ring);
+  return scan_pool_array(action, only_young, data, dir->pools, dir->len);
+}
+
+/* Parallel major scanning (opt-in, see `boxroot_set_scan_helpers`).
+   Helper threads scan partitions of a large old directory while the
+   scanning domain scans its own partition. Instead of calling the
+   scanning action, the helpers collect the addresses of the live
+   blocks in a buffer, which the scanning domain then replays through
+   the scanning action. Thus the action is only ever called from the
+   scanning domain. Helpers are shared by all domains: a domain that
+   finds them busy scans serially. */
+
+#define MAX_SCAN_HELPERS 16
+/* Below this number of old pools, the scan is done serially. */
+#define PARALLEL_SCAN_MIN_POOLS 256
+
+typedef struct {
+  value **roots;
+  int len;
+  int capacity;
+  /* Growing `roots` failed; some roots are missing. */
+  bool failed;
+} root_buf;
+
+typedef struct {
+  /* The partition to scan */
+  pool **pools;
+  int len;
+  /* Set by the scanning domain, cleared by the helper when done */
+  bool go;
+  int work;
+  root_buf buf;
+} scan_job;
+
+/* Protected by helpers_mutex */
+static struct {
+  int started;
+  int pending;
+  bool stop;
+  thread_t threads[MAX_SCAN_HELPERS];
+  scan_job jobs[MAX_SCAN_HELPERS];
+} helpers;
+
+static mutex_t helpers_mutex = BXR_MUTEX_INITIALIZER;
+static cond_t helpers_start = BXR_COND_INITIALIZER;
+static cond_t helpers_done = BXR_COND_INITIALIZER;
+/* Number of helpers to use, at most `helpers.started` */
+static atomic_int scan_helpers = 0;
+/* Whether a domain is using the helpers */
+static atomic_bool helpers_busy = false;
+
+/* The buffer of the current helper thread */
+static _Thread_local root_buf *collect_buf = NULL;
+
+static void push_root(value *p)
+{
+  root_buf *b = collect_buf;
+  if (b->len == b->capacity) {
+    if (b->failed) return;
+    int capacity = (b->capacity == 0) ? 4096 : 2 * b->capacity;
+    value **a = realloc(b->roots, capacity * sizeof(value *));
+    if (a == NULL) {
+      b->failed = true;
+      return;
+    }
+    b->roots = a;
+    b->capacity = capacity;
+  }
+  b->roots[b->len++] = p;
+}
+
+/* A scanning action that collects roots. Immediates need no
+   scanning. */
+#if OCAML_MULTICORE
+static void collect_root(void *data, value v, value *p)
+{
+  (void)data;
+  if (Is_block(v)) push_root(p);
+}
+#else
+static void collect_root(value v, value *p)
+{
+  if (Is_block(v)) push_root(p);
+}
+#endif
+
+static void * scan_helper(void *arg)
+{
+  scan_job *job = arg;
+  collect_buf = &job->buf;
+  bxr_mutex_lock(&helpers_mutex);
+  while (true) {
+    while (!job->go && !helpers.stop)
+      bxr_cond_wait(&helpers_start, &helpers_mutex);
+    if (helpers.stop) break;
+    bxr_mutex_unlock(&helpers_mutex);
+    /* The scanning domain holds STW on our behalf */
+    job->buf.len = 0;
+    job->buf.failed = false;
+    job->work = scan_pool_array(&collect_root, 0, NULL,
+                                job->pools, job->len);
+    bxr_mutex_lock(&helpers_mutex);
+    job->go = false;
+    if (--helpers.pending == 0) bxr_cond_broadcast(&helpers_done);
+  }
+  bxr_mutex_unlock(&helpers_mutex);
+  return NULL;
+}
+
+/* ownership required: STW, helpers_busy */
+static int scan_dir_parallel(scanning_action action, void *data,
+                             pool_dir *dir)
+{
+  int n = load_relaxed(&scan_helpers);
+  int chunk = dir->len / (n + 1);
+  bxr_mutex_lock(&helpers_mutex);
+  for (int i = 0; i < n; i++) {
+    scan_job *job = &helpers.jobs[i];
+    job->pools = dir->pools + i * chunk;
+    job->len = chunk;
+    job->go = true;
+  }
+  helpers.pending = n;
+  bxr_cond_broadcast(&helpers_start);
+  bxr_mutex_unlock(&helpers_mutex);
+  /* The last partition is ours */
+  int work = scan_pool_array(action, 0, data, dir->pools + n * chunk,
+                             dir->len - n * chunk);
+  bxr_mutex_lock(&helpers_mutex);
+  while (helpers.pending != 0)
+    bxr_cond_wait(&helpers_done, &helpers_mutex);
+  bxr_mutex_unlock(&helpers_mutex);
+  for (int i = 0; i < n; i++) {
+    scan_job *job = &helpers.jobs[i];
+    if (BXR_UNLIKELY(job->buf.failed)) {
+      /* Out of memory: scan the partition again ourselves */
+      work += scan_pool_array(action, 0, data, job->pools, job->len);
+      continue;
+    }
+    for (int j = 0; j < job->buf.len; j++) {
+      value *p = job->buf.roots[j];
+      CALL_GC_ACTION(action, data, *p, p);
+    }
+    work += job->work;
+  }
+  STATS_INCR(total_parallel_scans);
+  return work;
+}
+
+/* The old pools are darkened in one go at the start of the major
+   cycle. Darkening them across major slices instead would need:
+   - a snapshot-at-the-beginning barrier darkening the previous value
+     in `boxroot_delete` and `boxroot_modify` for the pools not yet
+     scanned, including for deletions from threads that hold no
+     domain lock, and thus cannot darken;
+   - a way to prevent marking from terminating while some pools are
+     not scanned yet, which the runtime does not offer to root
+     scanning hooks.
+   To shorten the pause, use helpers instead. */
+/* ownership required: STW */
+static int scan_old_dir(scanning_action action, void *data,
+                        pool_rings *local)
+{
+  pool_dir *dir = &local->old_dir;
+  if (load_relaxed(&scan_helpers) > 0 && !dir->failed
+      && dir->len >= PARALLEL_SCAN_MIN_POOLS
+      && !atomic_exchange(&helpers_busy, true)) {
+    int work = scan_dir_parallel(action, data, dir);
+    atomic_store(&helpers_busy, false);
+    return work;
+  }
+  return scan_dir(action, 0, data, dir, &local->old);
+}
+
+bool boxroot_set_scan_helpers(int n)
+{
+  if (n < 0) n = 0;
+  if (n > MAX_SCAN_HELPERS) n = MAX_SCAN_HELPERS;
+  bool res = true;
+  bxr_mutex_lock(&helpers_mutex);
+  if (helpers.stop) {
+    res = false;
+    n = 0;
+  }
+  while (helpers.started < n) {
+    int i = helpers.started;
+    if (!bxr_thread_create(&helpers.threads[i], &scan_helper,
+                           &helpers.jobs[i])) {
+      res = false;
+      n = helpers.started;
+      break;
+    }
+    helpers.started++;
+  }
+  store_relaxed(&scan_helpers, n);
+  bxr_mutex_unlock(&helpers_mutex);
+  return res;
+}
+
+/* ownership required: none, after OCaml shut down */
+static void stop_scan_helpers(void)
+{
+  bxr_mutex_lock(&helpers_mutex);
+  store_relaxed(&scan_helpers, 0);
+  helpers.stop = true;
+  bxr_cond_broadcast(&helpers_start);
+  bxr_mutex_unlock(&helpers_mutex);
+  for (int i = 0; i < helpers.started; i++) {
+    bxr_thread_join(helpers.threads[i]);
+    free(helpers.jobs[i].buf.roots);
+  }
+  helpers.started = 0;
+}
+
+/* The number of pools scanned by `scan_dir` */
+/* ownership required: STW */
+static int dir_scan_length(pool_dir *dir, pool *ring)
+{
+  if (!dir->failed) return dir->len;
+  int len = 0;
+  pool *p = ring;
+  if (p != NULL) do { len++; p = p->next; } while (p != ring);
+  return len;
+}
+
 /* ownership required: STW */
 static int scan_pools(scanning_action action, int only_young,
                       void *data, int dom_id)
 {
   pool_rings *local = pools[dom_id];
-  int work = scan_ring(action, only_young, data, &local->young);
-  if (!only_young) work += scan_ring(action, 0, data, &local->old);
+  int work = scan_dir(action, only_young, data, &local->young_dir,
+                      &local->young);
+  if (!only_young) work += scan_old_dir(action, data, local);
   return work;
 }
 
@@ -988,19 +3097,30 @@ static void scan_roots(scanning_action action, int only_young,
   if (BOXROOT_DEBUG) validate_all_pools(dom_id);
   move_current_to_young(dom_id);
   /* First perform all the delayed deallocations. */
+  long long start = time_counter();
   gc_pool_rings(dom_id);
+  long long adopt_start = time_counter();
+  EMIT_DURATION(EV_GC_POOL_RINGS, adopt_start - start);
   /* The first domain arriving there will take ownership of the pools
      of terminated domains. */
   adopt_orphaned_pools(dom_id);
+  EMIT_DURATION(EV_ADOPT_ORPHANS, time_counter() - adopt_start);
   int work = scan_pools(action, only_young, data, dom_id);
+  pool_rings *local = pools[dom_id];
+  int scanned = dir_scan_length(&local->young_dir, local->young);
+  if (!only_young) scanned += dir_scan_length(&local->old_dir, local->old);
+  EMIT_INT(EV_SCANNED_POOLS, scanned);
+  EMIT_INT(EV_SCAN_WORK, work);
+  observe_lifetimes(dom_id, only_young);
   if (bxr_in_minor_collection()) {
     promote_young_pools(dom_id);
   } else {
-    free_pool_ring(&pools[dom_id]->free);
+    trim_free_pools(dom_id);
   }
   if (STATS) {
-    if (only_young) stats.total_scanning_work_minor += work;
-    else stats.total_scanning_work_major += work;
+    domain_stats *ds = &DOMAIN_STATS(dom_id);
+    if (only_young) ds->total_scanning_work_minor += work;
+    else ds->total_scanning_work_major += work;
   }
   if (BOXROOT_DEBUG) validate_all_pools(dom_id);
 }
@@ -1009,15 +3129,113 @@ static void scan_roots(scanning_action action, int only_young,
 
 /* {{{ Statistics */
 
+/* Cheap enough to be called inside STW sections, see
+   `bxr_clock_ticks`. */
 static long long time_counter(void)
 {
-#if defined(POSIX_CLOCK) && STATS
-  struct timespec t;
-  clock_gettime(CLOCK_MONOTONIC, &t);
-  return (long long)t.tv_sec * (long long)1000000000 + (long long)t.tv_nsec;
-#else
-  return 0;
-#endif
+  return STATS ? bxr_clock_ticks() : 0;
+}
+
+static long long ns_of_ticks(long long ticks, double ns_per_tick)
+{
+  return (long long)((double)ticks * ns_per_tick);
+}
+
+/* Log-linear histograms of scan times, in ticks: exact below
+   2 * HIST_SUB, then HIST_SUB buckets per power of two, up to
+   2^HIST_MAX_LOG ticks (the last bucket also counts the longer
+   times). */
+#define HIST_SUB_BITS 3
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_MAX_LOG 40
+#define HIST_BUCKETS BOXROOT_SCAN_HISTOGRAM_BUCKETS
+static_assert(HIST_BUCKETS == (HIST_MAX_LOG - HIST_SUB_BITS + 1) * HIST_SUB,
+              "BOXROOT_SCAN_HISTOGRAM_BUCKETS does not match");
+
+typedef struct {
+  atomic_llong minor[HIST_BUCKETS];
+  atomic_llong major[HIST_BUCKETS];
+} scan_histograms;
+
+/* Written by each domain inside its scanning callback. */
+static scan_histograms histograms[Num_domains];
+
+static int hist_bucket(long long ticks)
+{
+  if (ticks < 2 * HIST_SUB) return ticks < 0 ? 0 : (int)ticks;
+  int e = log2_floor(ticks);
+  if (e >= HIST_MAX_LOG) return HIST_BUCKETS - 1;
+  return (e - HIST_SUB_BITS + 1) * HIST_SUB
+    + (int)((ticks >> (e - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+/* Lower bound of bucket [i], in ticks, for i in [0, HIST_BUCKETS] */
+static long long hist_bound(int i)
+{
+  if (i < 2 * HIST_SUB) return i;
+  int e = i / HIST_SUB + HIST_SUB_BITS - 1;
+  long long m = HIST_SUB + i % HIST_SUB;
+  return m << (e - HIST_SUB_BITS);
+}
+
+/* Returns the bucket */
+/* ownership required: domain */
+static int record_scan_time(int dom_id, bool minor, long long ticks)
+{
+  scan_histograms *h = &histograms[dom_id];
+  int bucket = hist_bucket(ticks);
+  incr(&(minor ? h->minor : h->major)[bucket]);
+  return bucket;
+}
+
+/* Upper bound in ticks of the bucket containing the [q]-quantile */
+static long long hist_quantile(long long *counts, double q)
+{
+  long long total = 0;
+  for (int i = 0; i < HIST_BUCKETS; i++) total += counts[i];
+  if (total == 0) return 0;
+  long long rank = (long long)(q * (double)total);
+  if (rank >= total) rank = total - 1;
+  long long seen = 0;
+  int i = 0;
+  for (; i < HIST_BUCKETS - 1; i++) {
+    seen += counts[i];
+    if (seen > rank) break;
+  }
+  return hist_bound(i + 1);
+}
+
+/* Add the histogram of domain [dom_id] to [counts] */
+static void add_histogram(long long *counts, int dom_id, bool minor)
+{
+  atomic_llong *h = minor ? histograms[dom_id].minor : histograms[dom_id].major;
+  for (int i = 0; i < HIST_BUCKETS; i++) counts[i] += load_relaxed(&h[i]);
+}
+
+void boxroot_get_scan_histogram(bool minor, long long *counts)
+{
+  for (int i = 0; i < HIST_BUCKETS; i++) counts[i] = 0;
+  for (int i = 0; i < Num_domains; i++) add_histogram(counts, i, minor);
+}
+
+long long boxroot_scan_histogram_bound(int i)
+{
+  if (i < 0) i = 0;
+  if (i > HIST_BUCKETS) i = HIST_BUCKETS;
+  return ns_of_ticks(hist_bound(i), bxr_ns_per_tick());
+}
+
+void boxroot_get_lifetime_histogram(int kind, long long *counts)
+{
+  for (int b = 0; b < BOXROOT_LIFETIME_BUCKETS; b++) counts[b] = 0;
+  for (int i = 0; i < Num_domains; i++) {
+    lifetime_histograms *h = &lifetimes[i];
+    atomic_llong *l = (kind == BOXROOT_DEATHS_BY_MINORS) ? h->deaths_by_minors
+      : (kind == BOXROOT_DEATHS_BY_MAJORS) ? h->deaths_by_majors
+      : h->live_by_majors;
+    for (int b = 0; b < BOXROOT_LIFETIME_BUCKETS; b++)
+      counts[b] += load_relaxed(&l[b]);
+  }
 }
 
 // unit: 1=KiB, 2=MiB
@@ -1035,52 +3253,182 @@ static double average(long long total, long long units)
 }
 
 /* ownership required: none */
+static void add_domain_stats(struct boxroot_stats *s, domain_stats *ds)
+{
+  s->minor_collections += load_relaxed(&ds->minor_collections);
+  s->major_collections += load_relaxed(&ds->major_collections);
+  s->total_create_young += load_relaxed(&ds->total_create_young);
+  s->total_create_old += load_relaxed(&ds->total_create_old);
+  s->total_create_slow += load_relaxed(&ds->total_create_slow);
+  s->total_delete_young += load_relaxed(&ds->total_delete_young);
+  s->total_delete_old += load_relaxed(&ds->total_delete_old);
+  s->total_delete_slow += load_relaxed(&ds->total_delete_slow);
+  s->total_modify += load_relaxed(&ds->total_modify);
+  s->total_modify_slow += load_relaxed(&ds->total_modify_slow);
+  s->total_gc_pool_rings += load_relaxed(&ds->total_gc_pool_rings);
+  s->total_remote_flushes += load_relaxed(&ds->total_remote_flushes);
+  s->total_delete_lockless += load_relaxed(&ds->total_delete_lockless);
+  s->total_lockless_backoffs += load_relaxed(&ds->total_lockless_backoffs);
+  s->total_parallel_scans += load_relaxed(&ds->total_parallel_scans);
+  s->total_scanning_work_minor += load_relaxed(&ds->total_scanning_work_minor);
+  s->total_scanning_work_major += load_relaxed(&ds->total_scanning_work_major);
+  s->young_slots_skipped += load_relaxed(&ds->young_slots_skipped);
+  s->young_hit_young += load_relaxed(&ds->young_hit_young);
+  s->young_hit_gen += load_relaxed(&ds->young_hit_gen);
+  s->total_deaths += load_relaxed(&ds->total_deaths);
+  s->deaths_before_minor += load_relaxed(&ds->deaths_before_minor);
+  s->total_minor_time += load_relaxed(&ds->total_minor_time);
+  s->total_major_time += load_relaxed(&ds->total_major_time);
+  long long peak_minor = load_relaxed(&ds->peak_minor_time);
+  long long peak_major = load_relaxed(&ds->peak_major_time);
+  if (peak_minor > s->peak_minor_time) s->peak_minor_time = peak_minor;
+  if (peak_major > s->peak_major_time) s->peak_major_time = peak_major;
+  s->total_alloced_pools += load_relaxed(&ds->total_alloced_pools);
+  s->total_emptied_pools += load_relaxed(&ds->total_emptied_pools);
+  s->total_freed_pools += load_relaxed(&ds->total_freed_pools);
+  s->total_decommitted_pools += load_relaxed(&ds->total_decommitted_pools);
+  s->total_recommitted_pools += load_relaxed(&ds->total_recommitted_pools);
+  s->decommitted_pools += load_relaxed(&ds->decommitted_pools);
+  s->free_pools_target += load_relaxed(&ds->free_pools_target);
+  s->sparse_pools += load_relaxed(&ds->sparse_pools);
+  s->ring_operations += load_relaxed(&ds->ring_operations);
+}
+
+/* Convert the times of [s] to nanoseconds, and compute the
+   percentiles from the histograms [minor] and [major]. */
+static void convert_times(struct boxroot_stats *s, double ns_per_tick)
+{
+  s->total_minor_time = ns_of_ticks(s->total_minor_time, ns_per_tick);
+  s->total_major_time = ns_of_ticks(s->total_major_time, ns_per_tick);
+  s->peak_minor_time = ns_of_ticks(s->peak_minor_time, ns_per_tick);
+  s->peak_major_time = ns_of_ticks(s->peak_major_time, ns_per_tick);
+}
+
+static void finish_stats(struct boxroot_stats *s,
+                         long long *minor, long long *major)
+{
+  double ns_per_tick = bxr_ns_per_tick();
+  convert_times(s, ns_per_tick);
+  s->minor_time_p50 = ns_of_ticks(hist_quantile(minor, 0.5), ns_per_tick);
+  s->minor_time_p99 = ns_of_ticks(hist_quantile(minor, 0.99), ns_per_tick);
+  s->minor_time_p999 = ns_of_ticks(hist_quantile(minor, 0.999), ns_per_tick);
+  s->major_time_p50 = ns_of_ticks(hist_quantile(major, 0.5), ns_per_tick);
+  s->major_time_p99 = ns_of_ticks(hist_quantile(major, 0.99), ns_per_tick);
+  s->major_time_p999 = ns_of_ticks(hist_quantile(major, 0.999), ns_per_tick);
+}
+
+/* ownership required: none */
+bool boxroot_get_domain_stats(int dom_id, struct boxroot_stats *s)
+{
+  if (dom_id < -1 || dom_id >= Num_domains) return false;
+  *s = (struct boxroot_stats){ 0 };
+  add_domain_stats(s, &DOMAIN_STATS(dom_id));
+  long long minor[HIST_BUCKETS] = { 0 }, major[HIST_BUCKETS] = { 0 };
+  if (dom_id >= 0) {
+    add_histogram(minor, dom_id, true);
+    add_histogram(major, dom_id, false);
+  }
+  finish_stats(s, minor, major);
+  return true;
+}
+
+/* ownership required: none */
+void boxroot_get_stats(struct boxroot_stats *s)
+{
+  *s = (struct boxroot_stats){ 0 };
+  for (int i = -1; i < Num_domains; i++) {
+    add_domain_stats(s, &DOMAIN_STATS(i));
+  }
+  s->live_pools = load_relaxed(&stats.live_pools);
+  s->peak_pools = load_relaxed(&stats.peak_pools);
+  s->free_pools_min = FREE_POOLS_MIN;
+  s->free_pools_max = FREE_POOLS_MAX;
+  s->committed_bytes = committed_bytes();
+  long long minor[HIST_BUCKETS], major[HIST_BUCKETS];
+  boxroot_get_scan_histogram(true, minor);
+  boxroot_get_scan_histogram(false, major);
+  finish_stats(s, minor, major);
+}
+
+/* ownership required: none */
+void boxroot_get_scan_counters(struct boxroot_scan_counters *c)
+{
+  struct boxroot_stats s;
+  boxroot_get_stats(&s);
+  c->minor_collections = s.minor_collections;
+  c->major_collections = s.major_collections;
+  c->scanning_work_minor = s.total_scanning_work_minor;
+  c->scanning_work_major = s.total_scanning_work_major;
+  c->minor_time = s.total_minor_time;
+  c->major_time = s.total_major_time;
+}
+
 void boxroot_print_stats()
 {
+  struct boxroot_stats s;
+  boxroot_get_stats(&s);
+
   printf("minor collections: %'lld\n"
          "major collections (and others): %'lld\n",
-         stats.minor_collections,
-         stats.major_collections);
+         s.minor_collections,
+         s.major_collections);
 
-  if (stats.total_alloced_pools == 0) return;
+  if (s.total_alloced_pools == 0) return;
 
   printf("BXR_POOL_LOG_SIZE: %d (%'lld KiB, %'d roots/pool)\n"
          "BOXROOT_DEBUG: %d\n"
          "OCAML_MULTICORE: %d\n"
          "BXR_MULTITHREAD: %d\n"
-         "BXR_FORCE_REMOTE: %d\n",
+         "BXR_FORCE_REMOTE: %d\n"
+         "young scanning kernel: %s\n",
          (int)BXR_POOL_LOG_SIZE, kib_of_pools(1, 1), (int)POOL_CAPACITY,
          (int)BOXROOT_DEBUG, (int)OCAML_MULTICORE,
-         (int)BXR_MULTITHREAD, (int)BXR_FORCE_REMOTE);
+         (int)BXR_MULTITHREAD, (int)BXR_FORCE_REMOTE,
+         use_avx2 ? "avx2" : "scalar");
 
   printf("total allocated pools: %'lld (%'lld MiB)\n"
          "peak allocated pools: %'lld (%'lld MiB)\n"
          "total emptied pools: %'lld (%'lld MiB)\n"
          "total freed pools: %'lld (%'lld MiB)\n",
-         stats.total_alloced_pools,
-         kib_of_pools(stats.total_alloced_pools, 2),
-         stats.peak_pools,
-         kib_of_pools(stats.peak_pools, 2),
-         stats.total_emptied_pools,
-         kib_of_pools(stats.total_emptied_pools, 2),
-         stats.total_freed_pools,
-         kib_of_pools(stats.total_freed_pools, 2));
+         s.total_alloced_pools,
+         kib_of_pools(s.total_alloced_pools, 2),
+         s.peak_pools,
+         kib_of_pools(s.peak_pools, 2),
+         s.total_emptied_pools,
+         kib_of_pools(s.total_emptied_pools, 2),
+         s.total_freed_pools,
+         kib_of_pools(s.total_freed_pools, 2));
+
+  printf("empty pools kept (min, max, current target): %'lld, %'lld, %'lld\n"
+         "total decommitted pools: %'lld (%'lld reused)\n"
+         "decommitted pools: %'lld (%'lld MiB)\n"
+         "committed memory: %'lld MiB\n"
+         "sparse pools (at most 1/%d full): %'lld\n",
+         s.free_pools_min, s.free_pools_max, s.free_pools_target,
+         s.total_decommitted_pools, s.total_recommitted_pools,
+         s.decommitted_pools, kib_of_pools(s.decommitted_pools, 2),
+         s.committed_bytes >> 20,
+         SPARSE_POOL_RATIO, s.sparse_pools);
 
   double scanning_work_minor =
-    average(stats.total_scanning_work_minor, stats.minor_collections);
+    average(s.total_scanning_work_minor, s.minor_collections);
   double scanning_work_major =
-    average(stats.total_scanning_work_major, stats.major_collections);
+    average(s.total_scanning_work_major, s.major_collections);
   long long total_scanning_work =
-    stats.total_scanning_work_minor + stats.total_scanning_work_major;
+    s.total_scanning_work_minor + s.total_scanning_work_major;
 #if BOXROOT_DEBUG
   double young_hits_gen_pct =
-    average(stats.young_hit_gen * 100, stats.total_scanning_work_major);
+    average(s.young_hit_gen * 100, s.total_scanning_work_major);
 #endif
   double young_hits_young_pct =
-    average(stats.young_hit_young * 100, stats.total_scanning_work_minor);
+    average(s.young_hit_young * 100, s.total_scanning_work_minor);
+
+  double young_slots_skipped =
+    average(s.young_slots_skipped, s.minor_collections);
 
   printf("work per minor: %'.0f\n"
          "work per major: %'.0f\n"
+         "slots skipped per minor (high-water mark): %'.0f\n"
          "total scanning work: %'lld (%'lld minor, %'lld major)\n"
 #if BOXROOT_DEBUG
          "young hits (non-minor collection): %.2f%%\n"
@@ -1088,68 +3436,221 @@ void boxroot_print_stats()
          "young hits (minor collection): %.2f%%\n",
          scanning_work_minor,
          scanning_work_major,
-         total_scanning_work, stats.total_scanning_work_minor, stats.total_scanning_work_major,
+         young_slots_skipped,
+         total_scanning_work, s.total_scanning_work_minor, s.total_scanning_work_major,
 #if BOXROOT_DEBUG
          young_hits_gen_pct,
 #endif
          young_hits_young_pct);
 
+  printf("deaths before any collection: %.2f%% (of %'lld)\n",
+         average(s.deaths_before_minor * 100, s.total_deaths),
+         s.total_deaths);
+
+  printf("parallel major scans: %'lld (helpers: %d)\n",
+         s.total_parallel_scans, load_relaxed(&scan_helpers));
+
 #if defined(POSIX_CLOCK)
   double time_per_minor =
-    average(stats.total_minor_time, stats.minor_collections) / 1000;
+    average(s.total_minor_time, s.minor_collections) / 1000;
   double time_per_major =
-    average(stats.total_major_time, stats.major_collections) / 1000;
+    average(s.total_major_time, s.major_collections) / 1000;
 
   printf("average time per minor: %'.3fµs\n"
          "average time per major: %'.3fµs\n"
          "peak time per minor: %'.3fµs\n"
-         "peak time per major: %'.3fµs\n",
+         "peak time per major: %'.3fµs\n"
+         "time per minor (p50, p99, p99.9): %'.3fµs, %'.3fµs, %'.3fµs\n"
+         "time per major (p50, p99, p99.9): %'.3fµs, %'.3fµs, %'.3fµs\n",
          time_per_minor,
          time_per_major,
-         ((double)stats.peak_minor_time) / 1000,
-         ((double)stats.peak_major_time) / 1000);
+         ((double)s.peak_minor_time) / 1000,
+         ((double)s.peak_major_time) / 1000,
+         ((double)s.minor_time_p50) / 1000,
+         ((double)s.minor_time_p99) / 1000,
+         ((double)s.minor_time_p999) / 1000,
+         ((double)s.major_time_p50) / 1000,
+         ((double)s.major_time_p99) / 1000,
+         ((double)s.major_time_p999) / 1000);
 #endif
 
   double ring_operations_per_pool =
-    average(stats.ring_operations, stats.total_alloced_pools);
+    average(s.ring_operations, s.total_alloced_pools);
 
   printf("total boxroot_create_slow: %'lld\n"
          "total boxroot_delete_slow: %'lld\n"
          "total boxroot_modify_slow: %'lld\n"
          "total ring operations: %'lld\n"
          "ring operations per pool: %.2f\n"
-         "total gc_pool_rings: %'lld\n",
-         stats.total_create_slow,
-         stats.total_delete_slow,
-         stats.total_modify_slow,
-         stats.ring_operations,
+         "total gc_pool_rings: %'lld\n"
+         "total remote buffer flushes: %'lld\n"
+         "total lock-less deletions: %'lld (%'lld backoffs)\n",
+         s.total_create_slow,
+         s.total_delete_slow,
+         s.total_modify_slow,
+         s.ring_operations,
          ring_operations_per_pool,
-         stats.total_gc_pool_rings);
+         s.total_gc_pool_rings,
+         s.total_remote_flushes,
+         s.total_delete_lockless,
+         s.total_lockless_backoffs);
 
 #if BOXROOT_DEBUG
-  long long total_create = stats.total_create_young + stats.total_create_old;
-  long long total_delete = stats.total_delete_young + stats.total_delete_old;
+  long long total_create = s.total_create_young + s.total_create_old;
+  long long total_delete = s.total_delete_young + s.total_delete_old;
   double create_young_pct =
-    average(stats.total_create_young * 100, total_create);
+    average(s.total_create_young * 100, total_create);
   double delete_young_pct =
-    average(stats.total_delete_young * 100, total_delete);
+    average(s.total_delete_young * 100, total_delete);
 
   printf("total created: %'lld (%.2f%% young)\n"
          "total deleted: %'lld (%.2f%% young)\n"
          "total modified: %'lld\n",
          total_create, create_young_pct,
          total_delete, delete_young_pct,
-         stats.total_modify);
+         s.total_modify);
 
+  /* Internal counters, not part of `struct boxroot_stats` */
+  long long get_pool_header = 0, is_pool_member = 0;
+  for (int i = -1; i < Num_domains; i++) {
+    get_pool_header += load_relaxed(&DOMAIN_STATS(i).get_pool_header);
+    is_pool_member += load_relaxed(&DOMAIN_STATS(i).is_pool_member);
+  }
   printf("get_pool_header: %'lld\n"
          "is_pool_member: %'lld\n",
-         stats.get_pool_header,
-         stats.is_pool_member);
+         get_pool_header,
+         is_pool_member);
 #endif
 }
 
 /* }}} */
 
+/* {{{ Exported statistics */
+
+/* See `boxroot_export_stats`. The file starts being updated once
+   `shm_header` is set. Each domain writes its own slot; the header
+   and the slot of the threads without a domain are written by any
+   domain that can take `shm_lock`. */
+static _Atomic(struct boxroot_shm_header *) shm_header = NULL;
+static atomic_flag shm_lock = ATOMIC_FLAG_INIT;
+static char shm_name[256];
+static size_t shm_size;
+/* Owns the variables above, except at `publish_stats` */
+static mutex_t shm_mutex = BXR_MUTEX_INITIALIZER;
+
+static struct boxroot_shm_slot * shm_slot(struct boxroot_shm_header *h,
+                                          int dom_id)
+{
+  char *slots = (char *)h + BOXROOT_SHM_SLOTS_OFFSET;
+  return (struct boxroot_shm_slot *)
+    (slots + (size_t)(dom_id + 1) * sizeof(struct boxroot_shm_slot));
+}
+
+static void shm_write_begin(_Atomic uint64_t *seq)
+{
+  atomic_store_explicit(seq, load_relaxed(seq) + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+static void shm_write_end(_Atomic uint64_t *seq)
+{
+  atomic_store_explicit(seq, load_relaxed(seq) + 1, memory_order_release);
+}
+
+/* Copy the counters of domain [dom_id] to its slot, with the buckets
+   of its histograms in [first, last). */
+static void publish_slot(struct boxroot_shm_header *h, int dom_id,
+                         double ns_per_tick, int first, int last)
+{
+  struct boxroot_shm_slot *slot = shm_slot(h, dom_id);
+  struct boxroot_stats s = { 0 };
+  add_domain_stats(&s, &DOMAIN_STATS(dom_id));
+  convert_times(&s, ns_per_tick);
+  shm_write_begin(&slot->seq);
+  slot->stats = s;
+  for (int i = first; i < last; i++) {
+    slot->minor_histogram[i] = load_relaxed(&histograms[dom_id].minor[i]);
+    slot->major_histogram[i] = load_relaxed(&histograms[dom_id].major[i]);
+  }
+  shm_write_end(&slot->seq);
+}
+
+/* ownership required: shm_lock */
+static void publish_header(struct boxroot_shm_header *h, double ns_per_tick)
+{
+  shm_write_begin(&h->seq);
+  h->ns_per_tick = ns_per_tick;
+  h->live_pools = load_relaxed(&stats.live_pools);
+  h->peak_pools = load_relaxed(&stats.peak_pools);
+  h->free_pools_min = FREE_POOLS_MIN;
+  h->free_pools_max = FREE_POOLS_MAX;
+  h->committed_bytes = committed_bytes();
+  shm_write_end(&h->seq);
+}
+
+/* Called at the end of each scan, [bucket] is the histogram bucket
+   that has just changed. */
+/* ownership required: domain */
+static void publish_stats(int dom_id, int bucket)
+{
+  struct boxroot_shm_header *h =
+    atomic_load_explicit(&shm_header, memory_order_acquire);
+  if (h == NULL) return;
+  double ns_per_tick = bxr_ns_per_tick();
+  publish_slot(h, dom_id, ns_per_tick, bucket, bucket + 1);
+  if (atomic_flag_test_and_set_explicit(&shm_lock, memory_order_acquire))
+    return;
+  publish_slot(h, -1, ns_per_tick, 0, 0);
+  publish_header(h, ns_per_tick);
+  atomic_flag_clear_explicit(&shm_lock, memory_order_release);
+}
+
+bool boxroot_export_stats(const char *name)
+{
+  bool res = false;
+  bxr_mutex_lock(&shm_mutex);
+  if (load_relaxed(&shm_header) != NULL) goto out;
+  /* Names of shared memory objects start with a slash */
+  int len = snprintf(shm_name, sizeof(shm_name), "%s%s",
+                     name[0] == '/' ? "" : "/", name);
+  if (len < 0 || len >= (int)sizeof(shm_name)) goto out;
+  shm_size = BOXROOT_SHM_SLOTS_OFFSET
+    + (Num_domains + 1) * sizeof(struct boxroot_shm_slot);
+  struct boxroot_shm_header *h = bxr_shm_create(shm_name, shm_size);
+  if (h == NULL) goto out;
+  h->magic = BOXROOT_SHM_MAGIC;
+  h->version = BOXROOT_SHM_VERSION;
+  h->stats_size = sizeof(struct boxroot_stats);
+  h->slot_size = sizeof(struct boxroot_shm_slot);
+  h->num_slots = Num_domains + 1;
+  h->pid = getpid();
+  for (int i = 0; i <= HIST_BUCKETS; i++) h->bucket_bounds[i] = hist_bound(i);
+  double ns_per_tick = bxr_ns_per_tick();
+  publish_header(h, ns_per_tick);
+  publish_slot(h, -1, ns_per_tick, 0, 0);
+  for (int i = 0; i < Num_domains; i++)
+    publish_slot(h, i, ns_per_tick, 0, HIST_BUCKETS);
+  atomic_store_explicit(&shm_header, h, memory_order_release);
+  res = true;
+ out:
+  bxr_mutex_unlock(&shm_mutex);
+  return res;
+}
+
+/* ownership required: none (OCaml has shut down) */
+static void stop_export_stats(void)
+{
+  bxr_mutex_lock(&shm_mutex);
+  struct boxroot_shm_header *h = load_relaxed(&shm_header);
+  if (h != NULL) {
+    store_relaxed(&shm_header, NULL);
+    bxr_shm_remove(shm_name, h, shm_size);
+  }
+  bxr_mutex_unlock(&shm_mutex);
+}
+
+/* }}} */
+
 /* {{{ Hook setup */
 
 /* ownership required: STW */
@@ -1159,21 +3660,40 @@ static void scanning_callback(scanning_action action, int only_young,
   if (boxroot_status() == BOXROOT_NOT_SETUP
       || boxroot_status() == BOXROOT_TORE_DOWN) return;
   bool in_minor_collection = bxr_in_minor_collection();
-  if (in_minor_collection) STATS_INCR(minor_collections);
-  else STATS_INCR(major_collections);
   int dom_id = Domain_id;
+  if (STATS) {
+    domain_stats *ds = &DOMAIN_STATS(dom_id);
+    if (in_minor_collection) incr(&ds->minor_collections);
+    else incr(&ds->major_collections);
+  }
   if (pools[dom_id] == NULL) return; /* synchronised by domain lock */
-#if !OCAML_MULTICORE
+  if (BOXROOT_TRACE && bxr_tracing)
+    trace_record(in_minor_collection ? BOXROOT_TRACE_MINOR_SCAN
+                                     : BOXROOT_TRACE_MAJOR_SCAN, NULL, 0);
+#if OCAML_MULTICORE
+  bxr_check_blocking_section_hook();
+#else
   if (!bxr_check_thread_hooks()) status = BOXROOT_INVALID;
 #endif
   long long start = time_counter();
+  /* Publish the buffered remote deallocations of this thread, which
+     otherwise keep their values alive (see `remote_bufs`). */
+  if (OCAML_MULTICORE) try_flush_remote_bufs();
+  atomic_fetch_add(&scanning_domains, 1);
   scan_roots(action, only_young, data, dom_id);
+  atomic_fetch_sub(&scanning_domains, 1);
+  if (OCAML_MULTICORE) try_flush_remote_bufs();
   long long duration = time_counter() - start;
+  EMIT_DURATION(in_minor_collection ? EV_MINOR_SCAN : EV_MAJOR_SCAN,
+                duration);
   if (STATS) {
-    atomic_llong *total = in_minor_collection ? &stats.total_minor_time : &stats.total_major_time;
-    atomic_llong *peak = in_minor_collection ? &stats.peak_minor_time : &stats.peak_major_time;
+    domain_stats *ds = &DOMAIN_STATS(dom_id);
+    atomic_llong *total = in_minor_collection ? &ds->total_minor_time : &ds->total_major_time;
+    atomic_llong *peak = in_minor_collection ? &ds->peak_minor_time : &ds->peak_major_time;
     *total += duration;
-    if (duration > *peak) *peak = duration; // racy, but whatever
+    if (duration > *peak) *peak = duration;
+    int bucket = record_scan_time(dom_id, in_minor_collection, duration);
+    publish_stats(dom_id, bucket);
   }
 }
 
@@ -1182,8 +3702,20 @@ static void scanning_callback(scanning_action action, int only_young,
 static void domain_termination_callback()
 {
   DEBUGassert(OCAML_MULTICORE == 1);
+  flush_remote_bufs();
   int dom_id = Domain_id;
+  atomic_fetch_add(&scanning_domains, 1);
   orphan_pools(dom_id);
+  atomic_fetch_sub(&scanning_domains, 1);
+}
+
+/* Publish the buffered remote deallocations and the queued runtime
+   events before releasing the domain lock */
+/* ownership required: current domain */
+static void enter_blocking_section_callback()
+{
+  flush_remote_bufs();
+  flush_events();
 }
 
 /* Used for initialization/teardown */
@@ -1199,7 +3731,29 @@ static bool setup()
     res = (status == BOXROOT_RUNNING);
     goto out;
   }
-  bxr_setup_hooks(&scanning_callback, &domain_termination_callback);
+  if (!bxr_initialize_thread_key(&remote_bufs_key,
+                                 &flush_remote_bufs_at_exit)) {
+    errno = ENOMEM;
+    res = false;
+    goto out;
+  }
+  for (int i = 0; i < SAMPLE_SHARDS; i++) {
+    if (!bxr_initialize_mutex(&samples[i].mutex)) {
+      errno = ENOMEM;
+      res = false;
+      goto out;
+    }
+  }
+  use_avx2 = BXR_SIMD_AVX2 && bxr_cpu_has_avx2();
+  bxr_clock_init();
+  const char *export_name = getenv("BOXROOT_STATS_SHM");
+  if (export_name != NULL && export_name[0] != '\0')
+    boxroot_export_stats(export_name);
+  const char *trace_path = getenv("BOXROOT_TRACE_FILE");
+  if (trace_path != NULL && trace_path[0] != '\0')
+    boxroot_trace_start(trace_path);
+  bxr_setup_hooks(&scanning_callback, &domain_termination_callback,
+                  &enter_blocking_section_callback);
   // we are done
   status = BOXROOT_RUNNING;
   // fall through
@@ -1216,16 +3770,22 @@ bool boxroot_setup() { return true; }
 void boxroot_teardown()
 {
   bxr_mutex_lock(&init_mutex);
+  stop_scan_helpers();
   if (status != BOXROOT_RUNNING) goto out;
   status = BOXROOT_TORE_DOWN;
+  /* OCaml has shut down */
+  disable_events();
+  stop_export_stats();
+  boxroot_trace_stop();
+  free_samples();
   for (int i = 0; i < Num_domains; i++) {
     pool_rings *ps = pools[i];
     if (ps == NULL) continue;
     free_pool_rings(ps);
-    free(ps);
     set_current_fl(i, &empty_fl);
   }
-  free_pool_rings(&orphan);
+  for (int n = 0; n < BXR_MAX_NUMA_NODES; n++)
+    free_pool_rings(&orphan[n]);
   // fall through
  out:
   bxr_mutex_unlock(&init_mutex);
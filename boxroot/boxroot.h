@@ -2,7 +2,11 @@
 #ifndef BOXROOT_H
 #define BOXROOT_H
 
+#include <stdalign.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include "boxroot_stats.h"
+#include "boxroot_trace.h"
 #include "ocaml_hooks.h"
 #include "platform.h"
 
@@ -18,6 +22,19 @@ typedef struct bxr_private* boxroot;
    initialization of Boxroot (see `boxroot_status`). */
 inline boxroot boxroot_create(value);
 
+/* `boxroot_create_n(vs, n, out)` allocates `n` boxroots, storing in
+   `out[i]` a new boxroot initialised to the value `vs[i]`. It is
+   equivalent to calling `boxroot_create` on each value in turn, but
+   performs the checks once and takes the slots from the free list in
+   runs. The OCaml domain lock must be held before calling
+   `boxroot_create_n`.
+
+   A return value of `false` indicates a failure of allocation or
+   initialization of Boxroot (see `boxroot_status`). In this case, no
+   boxroot remains allocated and the contents of `out` are
+   unspecified. */
+bool boxroot_create_n(const value *vs, size_t n, boxroot *out);
+
 /* `boxroot_get(r)` returns the contained value, subject to the usual
    discipline for non-rooted values. `boxroot_get_ref(r)` returns a
    pointer to a memory cell containing the value kept alive by `r`,
@@ -37,6 +54,18 @@ inline value const * boxroot_get_ref(boxroot r) { return (value *)r; }
    calling `boxroot_delete`.)*/
 inline void boxroot_delete(boxroot);
 
+/* `boxroot_delete_n(rs, n)` deallocates the boxroots `rs[0]`, ...,
+   `rs[n-1]`. It is equivalent to calling `boxroot_delete` on each of
+   them, but boxroots that belong to the same pool are released
+   together, with a single update of the free list of their pool.
+   Boxroots are grouped by pool within windows of 64 consecutive
+   boxroots spanning at most 8 pools, in any order. (Boxroots
+   allocated together, for instance with `boxroot_create_n`, tend to
+   belong to the same pool.) The
+   arguments must be non-null. (One does not need to hold the OCaml
+   domain lock before calling `boxroot_delete_n`.) */
+void boxroot_delete_n(boxroot *rs, size_t n);
+
 /* `boxroot_modify(&r,v)` changes the value kept alive by the boxroot
    `r` to `v`. It is essentially equivalent to the following:
    ```
@@ -86,6 +115,100 @@ enum {
 };
 int boxroot_status();
 
+/* `boxroot_set_scan_helpers(n)` makes Boxroot use `n` helper threads
+   (at most 16) to scan the roots of domains holding many boxroots at
+   the start of major collection. The helpers only read the boxroots:
+   the OCaml GC is still called from the domain being scanned. `n = 0`
+   (the default) disables helpers. A return value of `false`
+   indicates that some helper threads could not be started; the ones
+   that could are used. */
+bool boxroot_set_scan_helpers(int n);
+
+/* `boxroot_get_stats(s)` fills `s` with the sum of the counters of
+   all domains. Each domain has its own counters, which are read
+   without synchronisation: the totals are consistent only when
+   Boxroot is not in use concurrently. Cheap enough to be polled. */
+void boxroot_get_stats(struct boxroot_stats *s);
+
+/* `boxroot_get_domain_stats(dom_id, s)` fills `s` with the counters
+   of domain `dom_id`, or with the counters of the threads without a
+   domain if `dom_id` is -1. Returns `false` (leaving `s` untouched)
+   if `dom_id` is out of range. Some counters of a domain can be
+   negative when pools move between domains; only their total is
+   meaningful. */
+bool boxroot_get_domain_stats(int dom_id, struct boxroot_stats *s);
+
+/* The subset of `boxroot_get_stats` that the other root
+   implementations keep too (see boxroot_stats.h). */
+void boxroot_get_scan_counters(struct boxroot_scan_counters *c);
+
+/* Distribution of the time spent scanning boxroots per collection,
+   by log-linear buckets. `boxroot_get_scan_histogram(minor, counts)`
+   fills `counts[i]` with the number of minor (resp. major and other)
+   collections for which it took between
+   `boxroot_scan_histogram_bound(i)` and
+   `boxroot_scan_histogram_bound(i+1)` nanoseconds, summed over all
+   domains. The bounds are accurate to a few percent, and more so
+   the longer Boxroot has run. */
+void boxroot_get_scan_histogram(bool minor, long long *counts);
+long long boxroot_scan_histogram_bound(int i);
+
+/* Lifetimes of boxroots in numbers of collections, by power-of-two
+   buckets: `counts[0]` for 0 and `counts[k]` for [2^(k-1), 2^k), for
+   `BOXROOT_LIFETIME_BUCKETS` buckets. `kind` is one of:
+   - `BOXROOT_DEATHS_BY_MINORS`: deleted boxroots, by the number of
+     minor collections they lived through,
+   - `BOXROOT_DEATHS_BY_MAJORS`: same, by major collections,
+   - `BOXROOT_LIVE_BY_MAJORS`: boxroots live at the last major
+     collection, by the number of major collections they lived
+     through.
+   Summed over all domains. Ages are estimated per pool rather than
+   per boxroot: a boxroot is considered born when its pool last
+   started receiving new boxroots, and deaths in old pools are only
+   noticed at major collections. The counts are thus approximate,
+   but cost nothing on allocation and deallocation. */
+void boxroot_get_lifetime_histogram(int kind, long long *counts);
+
+/* `boxroot_export_stats(name)` publishes the counters in the shared
+   memory file `name` (under /dev/shm on Linux), for reading by other
+   processes without cooperation from this one (see boxroot_stats.h
+   for the layout). Each domain updates its part at the end of each of
+   its scans. The file is removed by `boxroot_teardown`. Exporting can
+   also be enabled by setting the environment variable
+   BOXROOT_STATS_SHM to `name` before Boxroot is first used. Returns
+   `false` if the file cannot be created, or if the counters are
+   already exported. */
+bool boxroot_export_stats(const char *name);
+
+/* Allocation-site profiling, to find leaks. `boxroot_set_sampling(n)`
+   records the native backtrace of about one in `n` calls to
+   `boxroot_create` (on average, at random intervals), and keeps it
+   until the boxroot is deleted. `n = 0` (the default) stops sampling,
+   keeping the current samples. Each domain takes a new value into
+   account at its next allocation on the slow path. When disabled,
+   the cost is a decrement in `boxroot_create` and a test in
+   `boxroot_delete`. */
+void boxroot_set_sampling(int n);
+
+/* `boxroot_dump_profile(fd, top)` writes to the file descriptor `fd`
+   the `top` allocation sites with the most live samples, with their
+   backtraces. */
+void boxroot_dump_profile(int fd, int top);
+
+/* `boxroot_trace_start(path)` writes to the file `path` a record of
+   every creation, deletion and modification of a boxroot, and of
+   every scan, for replaying the workload later (see
+   boxroot_trace.h for the format). Only available when Boxroot is
+   compiled with BOXROOT_TRACE=1, otherwise returns `false`; also
+   returns `false` if the file cannot be created or if a trace is
+   already being written. Tracing can also be started by setting the
+   environment variable BOXROOT_TRACE_FILE to `path` before Boxroot is
+   first used. `boxroot_trace_stop()` ends the trace and closes the
+   file; it is also called by `boxroot_teardown`. Neither must be
+   called while other threads use Boxroot. */
+bool boxroot_trace_start(const char *path);
+void boxroot_trace_stop(void);
+
 /* Show some statistics on the standard output. */
 void boxroot_print_stats();
 
@@ -114,16 +237,39 @@ typedef struct bxr_free_list {
   int domain_id;
   /* kept in sync with its location in the pool rings. */
   int class;
+  /* number of sampled boxroots in the pool (see
+     `boxroot_set_sampling`) */
+  int sampled;
 } bxr_free_list;
 
 #define BXR_CLASS_YOUNG 0
 
 extern _Thread_local ptrdiff_t bxr_cached_dom_id;
-extern bxr_free_list *bxr_current_free_list[/*Num_domains + 1*/];
+
+/* Per-domain state, each on its own cache lines to avoid false
+   sharing between domains. Only the current free list is accessed
+   here; the rest of the block is private. Indexed by the domain id
+   plus one. */
+#define BXR_DOMAIN_STATE_SIZE 512
+typedef union bxr_domain_state {
+  struct {
+    bxr_free_list *current_free_list;
+    /* Creations left until the next sample */
+    long sample_countdown;
+  };
+  alignas(BXR_DOMAIN_STATE_SIZE) char bxr_private[BXR_DOMAIN_STATE_SIZE];
+} bxr_domain_state;
+
+extern bxr_domain_state bxr_domain_states[/*Num_domains + 1*/];
 
 void bxr_create_debug(value v);
 boxroot bxr_create_slow(value v);
 
+/* Whether a trace is being written. Only changes while no other
+   thread uses Boxroot. */
+extern bool bxr_tracing;
+void bxr_trace(int op, boxroot root, value v);
+
 /* Used to test the overheads of multithreading (systhreads and
    multicore) A value of false makes boxroot domain-local (no movement
    between domains allowed), and single-threaded (no deletion without
@@ -142,14 +288,20 @@ inline boxroot boxroot_create(value init)
 #endif
   /* Find current free_list. Synchronized by domain lock. */
   ptrdiff_t dom_id = OCAML_MULTICORE ? bxr_cached_dom_id : 0;
-  bxr_free_list *fl = bxr_current_free_list[dom_id + 1];
+  bxr_domain_state *state = &bxr_domain_states[dom_id + 1];
+  bxr_free_list *fl = state->current_free_list;
   bxr_slot_ref new_root = fl->next;
   if (BXR_UNLIKELY(BXR_MULTITHREAD && !bxr_domain_lock_held())
-      || BXR_UNLIKELY(new_root == (bxr_slot_ref)fl))
+      || BXR_UNLIKELY(new_root == (bxr_slot_ref)fl)
+      || BXR_UNLIKELY(--state->sample_countdown <= 0))
     return bxr_create_slow(init);
   fl->next = new_root->as_slot_ref;
   fl->alloc_count++;
   new_root->as_value = init;
+#if BOXROOT_TRACE
+  if (BXR_UNLIKELY(bxr_tracing))
+    bxr_trace(BOXROOT_TRACE_CREATE, (boxroot)new_root, init);
+#endif
   return (boxroot)new_root;
 }
 
@@ -181,13 +333,18 @@ inline bool bxr_free_slot(bxr_free_list *fl, boxroot root)
 
 void bxr_delete_debug(boxroot root);
 void bxr_delete_slow(bxr_free_list *fl, boxroot root, bool remote);
+void bxr_forget_sample(bxr_free_list *fl, boxroot root);
 
 inline void boxroot_delete(boxroot root)
 {
 #if defined(BOXROOT_DEBUG) && BOXROOT_DEBUG
   bxr_delete_debug(root);
+#endif
+#if BOXROOT_TRACE
+  if (BXR_UNLIKELY(bxr_tracing)) bxr_trace(BOXROOT_TRACE_DELETE, root, 0);
 #endif
   bxr_free_list *fl = Bxr_get_pool_header(root);
+  if (BXR_UNLIKELY(fl->sampled != 0)) bxr_forget_sample(fl, root);
   bool remote_dom_id =
     OCAML_MULTICORE ? fl->domain_id != bxr_cached_dom_id : false;
   bool remote =
@@ -212,6 +369,10 @@ inline bool boxroot_modify(boxroot *rootp, value new_value)
   bxr_free_list *fl = Bxr_get_pool_header(s);
   if (BXR_LIKELY(fl->class == BXR_CLASS_YOUNG)) {
     s->as_value = new_value;
+#if BOXROOT_TRACE
+    if (BXR_UNLIKELY(bxr_tracing))
+      bxr_trace(BOXROOT_TRACE_MODIFY, (boxroot)s, new_value);
+#endif
     return 1;
   } else {
     /* We might need to reallocate, but this reallocation happens at
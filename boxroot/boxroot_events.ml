@@ -0,0 +1,33 @@
+(* SPDX-License-Identifier: MIT *)
+
+open Runtime_events
+
+type User.tag += Boxroot
+
+let minor_scan = User.register "boxroot.minor_scan" Boxroot Type.int
+let major_scan = User.register "boxroot.major_scan" Boxroot Type.int
+let gc_pool_rings = User.register "boxroot.gc_pool_rings" Boxroot Type.int
+let adopt_orphans = User.register "boxroot.adopt_orphans" Boxroot Type.int
+
+let scanned_pools = User.register "boxroot.scanned_pools" Boxroot Type.int
+let scan_work = User.register "boxroot.scan_work" Boxroot Type.int
+let pool_alloc = User.register "boxroot.pool_alloc" Boxroot Type.int
+let pool_free = User.register "boxroot.pool_free" Boxroot Type.int
+
+(* The order of the array must follow the enum in boxroot.c *)
+external enable_events : int User.t array -> unit = "boxroot_events_enable"
+
+external flush : unit -> unit = "boxroot_events_flush"
+
+let enable () =
+  enable_events
+    [| minor_scan
+     ; major_scan
+     ; gc_pool_rings
+     ; adopt_orphans
+     ; scanned_pools
+     ; scan_work
+     ; pool_alloc
+     ; pool_free
+    |]
+;;
@@ -0,0 +1,39 @@
+(* SPDX-License-Identifier: MIT *)
+
+(** Custom runtime events emitted by Boxroot (OCaml >= 5.1), for
+    consumers of [Runtime_events]. All events carry the tag
+    [Boxroot]. Nothing is emitted until [enable] is called.
+
+    The events of a domain are not written where they occur (often
+    inside the GC), but queued and written when the domain next
+    allocates a boxroot on the slow path, enters a blocking section,
+    or calls [flush]. Their timestamps are thus those of the writing.
+    A domain queues up to 32 events between two writes, and drops the
+    next ones. *)
+
+type Runtime_events.User.tag += Boxroot
+
+(** Duration of the scan of the boxroots of a domain, in
+    nanoseconds. *)
+val minor_scan : int Runtime_events.User.t
+val major_scan : int Runtime_events.User.t
+(** Durations of the delayed deallocations, and of the adoption of
+    the pools of terminated domains, in each scan. *)
+val gc_pool_rings : int Runtime_events.User.t
+val adopt_orphans : int Runtime_events.User.t
+
+(** Number of pools scanned (young pools only at minor collections),
+    at the end of each scan. *)
+val scanned_pools : int Runtime_events.User.t
+(** Scanning work (number of slots visited) of each scan. *)
+val scan_work : int Runtime_events.User.t
+(** Number of pools allocated by Boxroot, after the last allocation
+    (resp. release) of a pool before the events are written. *)
+val pool_alloc : int Runtime_events.User.t
+val pool_free : int Runtime_events.User.t
+
+(** Start emitting the events. *)
+val enable : unit -> unit
+
+(** Write the events queued by the current domain now. *)
+val flush : unit -> unit
@@ -0,0 +1,169 @@
+/* SPDX-License-Identifier: MIT */
+#ifndef BOXROOT_STATS_H
+#define BOXROOT_STATS_H
+
+/* Statistics of Boxroot, see `boxroot_get_stats` in boxroot.h. Does
+   not depend on OCaml, so that tools reading the statistics exported
+   by `boxroot_export_stats` can include it. */
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+/* Counters maintained by Boxroot. Times are in nanoseconds, and are
+   only measured on platforms with a POSIX monotonic clock. The
+   counts of young/old creations and deletions, and of modifications,
+   are only maintained when BOXROOT_DEBUG is set. */
+struct boxroot_stats {
+  long long minor_collections;
+  long long major_collections; /* and others */
+  long long total_create_young;
+  long long total_create_old;
+  long long total_create_slow;
+  long long total_delete_young;
+  long long total_delete_old;
+  long long total_delete_slow;
+  long long total_modify;
+  long long total_modify_slow;
+  long long total_gc_pool_rings;
+  long long total_remote_flushes;
+  long long total_delete_lockless;
+  long long total_lockless_backoffs;
+  long long total_parallel_scans;
+  long long total_scanning_work_minor;
+  long long total_scanning_work_major;
+  long long young_slots_skipped;
+  long long young_hit_young;
+  long long young_hit_gen;
+  /* Deallocations counted by the lifetime histograms (see
+     `boxroot_get_lifetime_histogram`), and those of boxroots that did
+     not live through any collection. */
+  long long total_deaths;
+  long long deaths_before_minor;
+  long long total_minor_time;
+  long long total_major_time;
+  long long peak_minor_time;
+  long long peak_major_time;
+  /* Percentiles of the scan time per collection (see
+     `boxroot_get_scan_histogram`), rounded up to a bucket bound. */
+  long long minor_time_p50;
+  long long minor_time_p99;
+  long long minor_time_p999;
+  long long major_time_p50;
+  long long major_time_p99;
+  long long major_time_p999;
+  long long total_alloced_pools;
+  long long total_emptied_pools;
+  long long total_freed_pools;
+  long long total_decommitted_pools;
+  long long total_recommitted_pools;
+  long long decommitted_pools;
+  long long free_pools_target;
+  /* Tracked pools at most 1/8 full, as of the last major scan of
+     each domain */
+  long long sparse_pools;
+  long long ring_operations;
+  /* Only for the totals: tracked pools, now and at peak; the bounds
+     of the number of empty pools each domain keeps committed at
+     major scans (`free_pools_target` sums the current numbers); an
+     estimate of the memory committed for pools, in bytes, counting
+     the free memory of partially used huge-page slabs. */
+  long long live_pools;
+  long long peak_pools;
+  long long free_pools_min;
+  long long free_pools_max;
+  long long committed_bytes;
+};
+
+/* Scanning counters that every root implementation keeps (see
+   `boxroot_get_scan_counters` and the like), for comparing them.
+   Work is in slots visited, time in nanoseconds. Implementations
+   that do not scan differently at minor collections count all their
+   work and time as major. */
+struct boxroot_scan_counters {
+  long long minor_collections;
+  long long major_collections;
+  long long scanning_work_minor;
+  long long scanning_work_major;
+  long long minor_time;
+  long long major_time;
+};
+
+/* Number of buckets of the scan-time histograms */
+#define BOXROOT_SCAN_HISTOGRAM_BUCKETS 304
+
+/* Number of buckets of the lifetime histograms, and their kinds */
+#define BOXROOT_LIFETIME_BUCKETS 32
+enum {
+  BOXROOT_DEATHS_BY_MINORS,
+  BOXROOT_DEATHS_BY_MAJORS,
+  BOXROOT_LIVE_BY_MAJORS,
+};
+
+/* {{{ Shared-memory layout */
+
+/* Layout of the file written by `boxroot_export_stats`: a header,
+   followed by `num_slots` slots of `slot_size` bytes. Slot 0 holds
+   the counters of the threads without a domain, slot `i + 1` those of
+   domain `i`. The totals are the sums of the slots, except for the
+   fields only kept for the totals, which are in the header.
+
+   Each part is written by one thread at a time and protected by a
+   sequence lock: readers retry while `seq` is odd or has changed
+   during the read (see `boxroot_shm_read`). A reader must check
+   `magic`, `version`, `stats_size` and `slot_size` before anything
+   else. */
+
+#define BOXROOT_SHM_MAGIC 0x5354415453525842ULL /* "BXRSTATS" */
+#define BOXROOT_SHM_VERSION 3
+
+struct boxroot_shm_slot {
+  alignas(64) _Atomic uint64_t seq;
+  /* Times in nanoseconds, percentiles left at 0 */
+  struct boxroot_stats stats;
+  /* Scan-time histograms, in clock ticks (see `bucket_bounds`) */
+  long long minor_histogram[BOXROOT_SCAN_HISTOGRAM_BUCKETS];
+  long long major_histogram[BOXROOT_SCAN_HISTOGRAM_BUCKETS];
+};
+
+struct boxroot_shm_header {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t stats_size; /* sizeof(struct boxroot_stats) */
+  uint32_t slot_size; /* sizeof(struct boxroot_shm_slot) */
+  uint32_t num_slots;
+  int64_t pid;
+  /* Lower bounds of the histogram buckets in ticks, constant */
+  long long bucket_bounds[BOXROOT_SCAN_HISTOGRAM_BUCKETS + 1];
+  alignas(64) _Atomic uint64_t seq;
+  double ns_per_tick;
+  long long live_pools;
+  long long peak_pools;
+  long long free_pools_min;
+  long long free_pools_max;
+  long long committed_bytes;
+};
+
+/* Offset of the first slot */
+#define BOXROOT_SHM_SLOTS_OFFSET \
+  ((sizeof(struct boxroot_shm_header) + 63) & ~(size_t)63)
+
+/* Seqlock-consistent copy of `size` bytes from `src` to `dst`, where
+   `src` is protected by `seq`. */
+static inline void boxroot_shm_read(_Atomic uint64_t *seq, void *dst,
+                                    const void *src, size_t size)
+{
+  uint64_t before, after = 0;
+  do {
+    before = atomic_load_explicit(seq, memory_order_acquire);
+    if (before & 1) continue;
+    for (size_t i = 0; i < size; i++)
+      ((char *)dst)[i] = ((const volatile char *)src)[i];
+    atomic_thread_fence(memory_order_acquire);
+    after = atomic_load_explicit(seq, memory_order_relaxed);
+  } while ((before & 1) || before != after);
+}
+
+/* }}} */
+
+#endif // BOXROOT_STATS_H
@@ -0,0 +1,65 @@
+(* SPDX-License-Identifier: MIT *)
+
+(* Must have the fields of [struct boxroot_stats] (boxroot_stats.h),
+   in the same order. *)
+type t = {
+  minor_collections : int;
+  major_collections : int;
+  total_create_young : int;
+  total_create_old : int;
+  total_create_slow : int;
+  total_delete_young : int;
+  total_delete_old : int;
+  total_delete_slow : int;
+  total_modify : int;
+  total_modify_slow : int;
+  total_gc_pool_rings : int;
+  total_remote_flushes : int;
+  total_delete_lockless : int;
+  total_lockless_backoffs : int;
+  total_parallel_scans : int;
+  total_scanning_work_minor : int;
+  total_scanning_work_major : int;
+  young_slots_skipped : int;
+  young_hit_young : int;
+  young_hit_gen : int;
+  total_deaths : int;
+  deaths_before_minor : int;
+  total_minor_time : int;
+  total_major_time : int;
+  peak_minor_time : int;
+  peak_major_time : int;
+  minor_time_p50 : int;
+  minor_time_p99 : int;
+  minor_time_p999 : int;
+  major_time_p50 : int;
+  major_time_p99 : int;
+  major_time_p999 : int;
+  total_alloced_pools : int;
+  total_emptied_pools : int;
+  total_freed_pools : int;
+  total_decommitted_pools : int;
+  total_recommitted_pools : int;
+  decommitted_pools : int;
+  free_pools_target : int;
+  sparse_pools : int;
+  ring_operations : int;
+  live_pools : int;
+  peak_pools : int;
+  free_pools_min : int;
+  free_pools_max : int;
+  committed_bytes : int;
+}
+
+external get : unit -> t = "boxroot_stats_get"
+external get_domain : int -> t option = "boxroot_stats_get_domain"
+
+external scan_histogram : minor:bool -> int array
+  = "boxroot_stats_scan_histogram"
+external scan_histogram_bound : int -> int
+  = "boxroot_stats_scan_histogram_bound"
+
+type lifetime_kind = Deaths_by_minors | Deaths_by_majors | Live_by_majors
+
+external lifetime_histogram : lifetime_kind -> int array
+  = "boxroot_stats_lifetime_histogram"
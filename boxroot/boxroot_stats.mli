@@ -0,0 +1,80 @@
+(* SPDX-License-Identifier: MIT *)
+
+(** Counters of Boxroot, see [struct boxroot_stats] in
+    boxroot_stats.h for their meaning. Times are in nanoseconds. *)
+type t = {
+  minor_collections : int;
+  major_collections : int;
+  total_create_young : int;
+  total_create_old : int;
+  total_create_slow : int;
+  total_delete_young : int;
+  total_delete_old : int;
+  total_delete_slow : int;
+  total_modify : int;
+  total_modify_slow : int;
+  total_gc_pool_rings : int;
+  total_remote_flushes : int;
+  total_delete_lockless : int;
+  total_lockless_backoffs : int;
+  total_parallel_scans : int;
+  total_scanning_work_minor : int;
+  total_scanning_work_major : int;
+  young_slots_skipped : int;
+  young_hit_young : int;
+  young_hit_gen : int;
+  total_deaths : int;
+  deaths_before_minor : int;
+  total_minor_time : int;
+  total_major_time : int;
+  peak_minor_time : int;
+  peak_major_time : int;
+  minor_time_p50 : int;
+  minor_time_p99 : int;
+  minor_time_p999 : int;
+  major_time_p50 : int;
+  major_time_p99 : int;
+  major_time_p999 : int;
+  total_alloced_pools : int;
+  total_emptied_pools : int;
+  total_freed_pools : int;
+  total_decommitted_pools : int;
+  total_recommitted_pools : int;
+  decommitted_pools : int;
+  free_pools_target : int;
+  sparse_pools : int;
+  ring_operations : int;
+  live_pools : int;
+  peak_pools : int;
+  free_pools_min : int;
+  free_pools_max : int;
+  committed_bytes : int;
+}
+
+(** The totals over all domains. Does not take any lock, and only
+    allocates the result. *)
+val get : unit -> t
+
+(** [get_domain d] returns the counters of domain [d], or of the
+    threads without a domain if [d = -1]. [None] if [d] is not a
+    valid domain index. *)
+val get_domain : int -> t option
+
+(** [scan_histogram ~minor] counts the minor (resp. major and other)
+    collections by the time spent scanning boxroots: element [i] is
+    the number of collections for which it took between
+    [scan_histogram_bound i] and [scan_histogram_bound (i + 1)]
+    nanoseconds. *)
+val scan_histogram : minor:bool -> int array
+val scan_histogram_bound : int -> int
+
+type lifetime_kind = Deaths_by_minors | Deaths_by_majors | Live_by_majors
+
+(** [lifetime_histogram k] counts the deleted boxroots by the number
+    of minor (resp. major) collections they lived through, or the
+    boxroots live at the last major collection by the number of major
+    collections they lived through. Element [0] is for 0 collections,
+    element [k > 0] for [2{^k-1}] to [2{^k} - 1] collections. The ages
+    are approximate, see [boxroot_get_lifetime_histogram] in
+    boxroot.h. *)
+val lifetime_histogram : lifetime_kind -> int array
@@ -0,0 +1,67 @@
+/* SPDX-License-Identifier: MIT */
+#define CAML_NAME_SPACE
+
+#include <caml/mlvalues.h>
+#include <caml/alloc.h>
+#include <caml/memory.h>
+#include "boxroot.h"
+
+/* The record `Boxroot_stats.t` has the fields of `struct
+   boxroot_stats`, in the same order, all of type int. */
+#define NUM_FIELDS (sizeof(struct boxroot_stats) / sizeof(long long))
+
+static value alloc_stats(struct boxroot_stats *s)
+{
+  long long *fields = (long long *)s;
+  value res = caml_alloc_tuple(NUM_FIELDS);
+  for (size_t i = 0; i < NUM_FIELDS; i++) {
+    Store_field(res, i, Val_long(fields[i]));
+  }
+  return res;
+}
+
+value boxroot_stats_get(value unit)
+{
+  struct boxroot_stats s;
+  boxroot_get_stats(&s);
+  return alloc_stats(&s);
+}
+
+value boxroot_stats_get_domain(value dom_id)
+{
+  CAMLparam1(dom_id);
+  CAMLlocal1(res);
+  struct boxroot_stats s;
+  if (!boxroot_get_domain_stats(Int_val(dom_id), &s)) CAMLreturn(Val_none);
+  res = alloc_stats(&s);
+  CAMLreturn(caml_alloc_some(res));
+}
+
+value boxroot_stats_scan_histogram(value minor)
+{
+  long long counts[BOXROOT_SCAN_HISTOGRAM_BUCKETS];
+  boxroot_get_scan_histogram(Bool_val(minor), counts);
+  value res = caml_alloc_tuple(BOXROOT_SCAN_HISTOGRAM_BUCKETS);
+  for (int i = 0; i < BOXROOT_SCAN_HISTOGRAM_BUCKETS; i++) {
+    Store_field(res, i, Val_long(counts[i]));
+  }
+  return res;
+}
+
+value boxroot_stats_scan_histogram_bound(value i)
+{
+  return Val_long(boxroot_scan_histogram_bound(Int_val(i)));
+}
+
+/* The constructors of `lifetime_kind` are in the order of the
+   `BOXROOT_*_BY_*` constants. */
+value boxroot_stats_lifetime_histogram(value kind)
+{
+  long long counts[BOXROOT_LIFETIME_BUCKETS];
+  boxroot_get_lifetime_histogram(Int_val(kind), counts);
+  value res = caml_alloc_tuple(BOXROOT_LIFETIME_BUCKETS);
+  for (int i = 0; i < BOXROOT_LIFETIME_BUCKETS; i++) {
+    Store_field(res, i, Val_long(counts[i]));
+  }
+  return res;
+}
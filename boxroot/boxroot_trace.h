@@ -0,0 +1,66 @@
+/* SPDX-License-Identifier: MIT */
+#ifndef BOXROOT_TRACE_H
+#define BOXROOT_TRACE_H
+
+/* Format of the traces written by `boxroot_trace_start`, see
+   boxroot.h. Does not depend on OCaml, so that tools reading traces
+   can include it. */
+
+#include <stdint.h>
+
+/* A trace is a `struct boxroot_trace_header` followed by records,
+   in no particular order: each thread writes its records by chunks.
+   Sorting them by `seq` gives the order in which the operations took
+   place (up to the races between threads). */
+
+#define BOXROOT_TRACE_MAGIC 0x4543415254525842ULL /* "BXRTRACE" */
+#define BOXROOT_TRACE_VERSION 1
+
+struct boxroot_trace_header {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t record_size; /* sizeof(struct boxroot_trace_record) */
+};
+
+/* Operations */
+enum {
+  /* `root` was created */
+  BOXROOT_TRACE_CREATE,
+  /* `root` was deleted */
+  BOXROOT_TRACE_DELETE,
+  /* `root` was modified */
+  BOXROOT_TRACE_MODIFY,
+  /* The root of the previous BOXROOT_TRACE_MODIFY of the same thread
+     was reallocated as `root` */
+  BOXROOT_TRACE_MOVE,
+  /* A domain scanned its boxroots, `root` is 0. Each domain records
+     the collections it takes part in. */
+  BOXROOT_TRACE_MINOR_SCAN,
+  BOXROOT_TRACE_MAJOR_SCAN,
+};
+
+/* Flags of BOXROOT_TRACE_CREATE and BOXROOT_TRACE_MODIFY: the kind of
+   the value stored. */
+enum {
+  BOXROOT_TRACE_IMMEDIATE,
+  BOXROOT_TRACE_YOUNG,
+  BOXROOT_TRACE_OLD,
+};
+
+struct boxroot_trace_record {
+  /* Global sequence number */
+  uint64_t seq;
+  /* Address of the boxroot, which identifies it until it is deleted
+     or moved. */
+  uint64_t root;
+  /* Small number identifying the thread, in order of first use */
+  uint32_t thread;
+  /* Domain of the thread, -1 if none */
+  int16_t domain;
+  uint8_t op;
+  /* For BOXROOT_TRACE_DELETE: 1 if the pool of the boxroot was young,
+     0 otherwise. */
+  uint8_t flags;
+};
+
+#endif // BOXROOT_TRACE_H
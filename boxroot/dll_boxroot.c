@@ -309,6 +309,16 @@ static int average(long long total_work, int nb_collections)
   return (total_work + (nb_collections / 2)) / nb_collections;
 }
 
+void dll_boxroot_get_scan_counters(struct boxroot_scan_counters *c)
+{
+  c->minor_collections = stats.minor_collections;
+  c->major_collections = stats.major_collections;
+  c->scanning_work_minor = stats.total_scanning_work_minor;
+  c->scanning_work_major = stats.total_scanning_work_major;
+  c->minor_time = stats.total_minor_time;
+  c->major_time = stats.total_major_time;
+}
+
 void dll_boxroot_print_stats()
 {
   printf("minor collections: %d\n"
@@ -386,7 +396,7 @@ int dll_boxroot_setup()
   rings.young = NULL;
   rings.old = NULL;
   rings.free = NULL;
-  bxr_setup_hooks(&scanning_callback, NULL);
+  bxr_setup_hooks(&scanning_callback, NULL, NULL);
   // we are done
   setup = 1;
   if (BOXROOT_DEBUG) validate_all_rings();
@@ -3,6 +3,7 @@
 #define DLL_BOXROOT_H
 
 #include <caml/mlvalues.h>
+#include "boxroot_stats.h"
 
 typedef struct dll_boxroot_private* dll_boxroot;
 
@@ -50,4 +51,7 @@ void dll_boxroot_teardown();
 /* Show some statistics on the standard output. */
 void dll_boxroot_print_stats();
 
+/* Fill `c` with the scanning counters (see boxroot_stats.h). */
+void dll_boxroot_get_scan_counters(struct boxroot_scan_counters *c);
+
 #endif // DLL_BOXROOT_H
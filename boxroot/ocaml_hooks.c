@@ -51,6 +51,11 @@ bool bxr_in_minor_collection()
 }
 
 static bxr_scanning_callback scanning_callback = NULL;
+static caml_timing_hook enter_blocking_section_callback = NULL;
+
+/* from <caml/signals.h> */
+CAMLextern void (*caml_leave_blocking_section_hook)(void);
+CAMLextern void (*caml_enter_blocking_section_hook)(void);
 
 #if OCAML_MULTICORE
 
@@ -77,10 +82,32 @@ static void domain_terminated_hook()
   (*domain_terminated_callback)();
 }
 
+static void (*prev_enter_blocking)(void);
+
+/* The systhreads library overwrites this hook without calling ours
+   when it is initialised after boxroot, see
+   `bxr_check_blocking_section_hook`. */
+static void bxr_enter_blocking_section(void)
+{
+  (*enter_blocking_section_callback)();
+  prev_enter_blocking();
+}
+
+void bxr_check_blocking_section_hook()
+{
+  if (enter_blocking_section_callback == NULL) return;
+  void (*hook)(void) = caml_enter_blocking_section_hook;
+  if (hook == bxr_enter_blocking_section) return;
+  prev_enter_blocking = hook;
+  caml_enter_blocking_section_hook = bxr_enter_blocking_section;
+}
+
 void bxr_setup_hooks(bxr_scanning_callback scanning,
-                     caml_timing_hook domain_termination)
+                     caml_timing_hook domain_termination,
+                     caml_timing_hook enter_blocking_section)
 {
   scanning_callback = scanning;
+  enter_blocking_section_callback = enter_blocking_section;
   // Save previous hooks and install ours.
   // prev_*_hook synchronized via domain lock since the hooks are called
   // during STW.
@@ -93,6 +120,10 @@ void bxr_setup_hooks(bxr_scanning_callback scanning,
   domain_terminated_callback = domain_termination;
   prev_domain_terminated_hook = atomic_exchange(&caml_domain_terminated_hook,
                                                 domain_terminated_hook);
+  if (enter_blocking_section != NULL) {
+    prev_enter_blocking = caml_enter_blocking_section_hook;
+    caml_enter_blocking_section_hook = bxr_enter_blocking_section;
+  }
 }
 
 #else
@@ -115,6 +146,8 @@ static void (*prev_leave_blocking)(void);
 
 static void bxr_enter_blocking_section(void)
 {
+  if (enter_blocking_section_callback != NULL)
+    (*enter_blocking_section_callback)();
   bxr_thread_has_lock = false;
   prev_enter_blocking();
 }
@@ -125,10 +158,6 @@ static void bxr_leave_blocking_section(void)
   bxr_thread_has_lock = true;
 }
 
-/* from <caml/signals.h> */
-CAMLextern void (*caml_leave_blocking_section_hook)(void);
-CAMLextern void (*caml_enter_blocking_section_hook)(void);
-
 static void setup_thread_hooks()
 {
   prev_leave_blocking = caml_leave_blocking_section_hook;
@@ -149,9 +178,11 @@ bool bxr_check_thread_hooks()
 }
 
 void bxr_setup_hooks(bxr_scanning_callback scanning,
-                     caml_timing_hook domain_termination)
+                     caml_timing_hook domain_termination,
+                     caml_timing_hook enter_blocking_section)
 {
   scanning_callback = scanning;
+  enter_blocking_section_callback = enter_blocking_section;
   // save previous hooks
   prev_scan_roots_hook = caml_scan_roots_hook;
   prev_minor_begin_hook = caml_minor_gc_begin_hook;
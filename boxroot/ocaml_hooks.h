@@ -50,13 +50,24 @@ extern _Thread_local bool bxr_thread_has_lock;
 typedef void (*bxr_scanning_callback) (scanning_action action,
                                        int only_young, void *data);
 
-/* Must be called while holding the domain lock */
+/* Must be called while holding the domain lock. `domain_termination`
+   and `enter_blocking_section` can be NULL. `enter_blocking_section`
+   is called while still holding the domain lock. */
 void bxr_setup_hooks(bxr_scanning_callback scanning,
-                     caml_timing_hook domain_termination);
+                     caml_timing_hook domain_termination,
+                     caml_timing_hook enter_blocking_section);
 
 bool bxr_in_minor_collection();
 
-#if !OCAML_MULTICORE
+#if OCAML_MULTICORE
+
+/* Reinstall the hook on `caml_enter_blocking_section_hook` on top of
+   the current one if it has been overwritten (by systhreads, which
+   does not chain it). Called during STW sections, so that no domain
+   is entering a blocking section meanwhile. */
+void bxr_check_blocking_section_hook();
+
+#else
 
 /* Used to regularly check that the hooks have not been overwritten.
    If they have, we place boxroot in safety mode. */
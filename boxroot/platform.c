@@ -3,7 +3,33 @@
 
 #include "platform.h"
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#if defined(__linux__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+#if defined(__GLIBC__) || defined(__APPLE__)
+#define HAS_BACKTRACE
+#include <execinfo.h>
+#endif
+#if defined(_POSIX_TIMERS) && defined(_POSIX_MONOTONIC_CLOCK)
+#define POSIX_CLOCK
+#include <time.h>
+#endif
+#if defined(__GNUC__) && defined(__x86_64__)
+#define USE_TSC 1
+#include <cpuid.h>
+#include <x86intrin.h>
+#else
+#define USE_TSC 0
+#endif
 
 #if OCAML_MULTICORE
 
@@ -14,23 +40,373 @@ static_assert(Max_domains <= Num_domains,
 
 #endif
 
-pool * bxr_alloc_uninitialised_pool(size_t size)
+/* {{{ NUMA */
+
+/* Pools are placed on the NUMA node of the thread that allocates
+   them, by setting the preferred node of their memory before it is
+   first touched. Without libnuma, we use the system calls directly
+   (Linux only). */
+
+#ifndef ENABLE_BOXROOT_NUMA
+#define ENABLE_BOXROOT_NUMA 1
+#endif
+
+#if ENABLE_BOXROOT_NUMA && defined(SYS_getcpu) && defined(SYS_mbind)
+#define USE_NUMA 1
+#define BXR_MPOL_PREFERRED 1 /* from <linux/mempolicy.h> */
+#else
+#define USE_NUMA 0
+#endif
+
+int bxr_numa_node(void)
+{
+#if USE_NUMA
+  unsigned cpu, node;
+  if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0
+      || node >= BXR_MAX_NUMA_NODES) return 0;
+  return (int)node;
+#else
+  return 0;
+#endif
+}
+
+/* Prefer [node] for the pages of [p, p + len) that are not yet
+   touched. Best effort. */
+static void prefer_numa_node(void *p, size_t len, int node)
+{
+#if USE_NUMA
+  static_assert(BXR_MAX_NUMA_NODES <= 8 * sizeof(unsigned long),
+                "NUMA node mask too small");
+  if (node < 0) return;
+  unsigned long mask = 1UL << node;
+  syscall(SYS_mbind, p, len, BXR_MPOL_PREFERRED, &mask,
+          8 * sizeof(mask) + 1, 0);
+#else
+  (void)p; (void)len; (void)node;
+#endif
+}
+
+/* }}} */
+
+/* {{{ Slabs */
+
+/* Pools are carved out of 2MB slabs, aligned on their size, that we
+   ask to be backed by transparent huge pages. This spares the malloc
+   heap from the fragmentation caused by large aligned allocations,
+   and reduces the number of TLB entries needed to scan the pools.
+   Pools of a size that does not fit, and pools that cannot be
+   obtained from a slab, come from posix_memalign.
+
+   The memory of a slab is given back to the OS as a whole, so as not
+   to split its huge page: once all its chunks are free, the slab is
+   unmapped, or decommitted if it is the last one (it then stays
+   mapped for reuse). Free chunks of a slab in use stay committed. */
+
+#ifndef ENABLE_BOXROOT_SLAB
+#define ENABLE_BOXROOT_SLAB 1
+#endif
+
+#if ENABLE_BOXROOT_SLAB && (defined(__linux__) || defined(__APPLE__))
+#define USE_SLABS 1
+#include <stdint.h>
+#if !defined(MAP_ANONYMOUS)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#else
+#define USE_SLABS 0
+#endif
+
+#if USE_SLABS
+
+#define SLAB_LOG_SIZE 21
+#define SLAB_SIZE ((size_t)1 << SLAB_LOG_SIZE)
+/* Smallest chunk: an OS page */
+#define SLAB_MIN_LOG_CHUNK 12
+#define SLAB_MAX_CHUNKS ((size_t)1 << (SLAB_LOG_SIZE - SLAB_MIN_LOG_CHUNK))
+#define SLAB_BITMAP_WORDS (SLAB_MAX_CHUNKS / 64)
+
+typedef struct slab {
+  /* In `slabs` if it has free chunks */
+  struct slab *next;
+  struct slab *prev;
+  char *base; /* aligned on SLAB_SIZE */
+  size_t chunk_size;
+  int node; /* preferred NUMA node, or -1 */
+  int free_count;
+  /* Entirely free, and its memory given back to the OS */
+  bool decommitted;
+  /* bit set = free chunk */
+  uint64_t free[SLAB_BITMAP_WORDS];
+} slab;
+
+/* Protected by slab_mutex: the slabs with free chunks, in a
+   doubly-linked list, and all slabs, sorted by base address. */
+static slab *slabs = NULL;
+static struct {
+  slab **slabs;
+  size_t len;
+  size_t capacity;
+} slab_index = { NULL, 0, 0 };
+static mutex_t slab_mutex = BXR_MUTEX_INITIALIZER;
+/* Bytes of the free chunks of the slabs not decommitted. Written
+   under slab_mutex. */
+static atomic_llong slab_free_bytes = 0;
+
+static bool fits_in_slab(size_t size)
+{
+  return (size & (size - 1)) == 0
+    && size >= ((size_t)1 << SLAB_MIN_LOG_CHUNK)
+    && size <= SLAB_SIZE / 2;
+}
+
+/* ownership required: slab_mutex */
+static void slab_list_push(slab *s)
+{
+  s->prev = NULL;
+  s->next = slabs;
+  if (slabs != NULL) slabs->prev = s;
+  slabs = s;
+}
+
+/* ownership required: slab_mutex */
+static void slab_list_remove(slab *s)
+{
+  if (s->prev != NULL) s->prev->next = s->next;
+  else slabs = s->next;
+  if (s->next != NULL) s->next->prev = s->prev;
+}
+
+/* The position of [base] in the index, or where to insert it */
+/* ownership required: slab_mutex */
+static size_t slab_index_search(char *base)
+{
+  size_t lo = 0, hi = slab_index.len;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (slab_index.slabs[mid]->base < base) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+/* ownership required: slab_mutex */
+static bool slab_index_insert(slab *s)
+{
+  if (slab_index.len == slab_index.capacity) {
+    size_t capacity = slab_index.capacity == 0 ? 16 : 2 * slab_index.capacity;
+    slab **grown = realloc(slab_index.slabs, capacity * sizeof(slab *));
+    if (grown == NULL) return false;
+    slab_index.slabs = grown;
+    slab_index.capacity = capacity;
+  }
+  size_t i = slab_index_search(s->base);
+  memmove(&slab_index.slabs[i + 1], &slab_index.slabs[i],
+          (slab_index.len - i) * sizeof(slab *));
+  slab_index.slabs[i] = s;
+  slab_index.len++;
+  return true;
+}
+
+/* ownership required: slab_mutex */
+static void slab_index_remove(slab *s)
+{
+  size_t i = slab_index_search(s->base);
+  assert(i < slab_index.len && slab_index.slabs[i] == s);
+  memmove(&slab_index.slabs[i], &slab_index.slabs[i + 1],
+          (slab_index.len - i - 1) * sizeof(slab *));
+  slab_index.len--;
+}
+
+static char * map_aligned_slab()
+{
+  /* Over-allocate, then trim to an aligned range */
+  size_t len = 2 * SLAB_SIZE;
+  char *raw = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED) return NULL;
+  char *base = (char *)(((uintptr_t)raw + SLAB_SIZE - 1)
+                        & ~((uintptr_t)SLAB_SIZE - 1));
+  if (base != raw) munmap(raw, base - raw);
+  char *end = base + SLAB_SIZE;
+  if (end != raw + len) munmap(end, raw + len - end);
+#if defined(MADV_HUGEPAGE)
+  madvise(base, SLAB_SIZE, MADV_HUGEPAGE);
+#endif
+  return base;
+}
+
+/* ownership required: slab_mutex */
+static slab * new_slab(size_t chunk_size, int node)
+{
+  slab *s = malloc(sizeof(slab));
+  if (s == NULL) return NULL;
+  s->base = map_aligned_slab();
+  if (s->base == NULL) { free(s); return NULL; }
+  prefer_numa_node(s->base, SLAB_SIZE, node);
+  s->chunk_size = chunk_size;
+  s->node = node;
+  s->decommitted = false;
+  size_t n = SLAB_SIZE / chunk_size;
+  s->free_count = (int)n;
+  for (size_t i = 0; i < SLAB_BITMAP_WORDS; i++) {
+    s->free[i] = (n >= 64) ? ~(uint64_t)0
+               : (n > 0) ? (((uint64_t)1 << n) - 1) : 0;
+    n = (n >= 64) ? n - 64 : 0;
+  }
+  if (!slab_index_insert(s)) {
+    munmap(s->base, SLAB_SIZE);
+    free(s);
+    return NULL;
+  }
+  slab_list_push(s);
+  slab_free_bytes += SLAB_SIZE;
+  return s;
+}
+
+/* A slab of any node will do if [node] is negative. */
+/* ownership required: slab_mutex */
+static void * slab_alloc(size_t size, int node)
+{
+  /* Only the slabs with free chunks are visited */
+  slab *s = slabs;
+  while (s != NULL && (s->chunk_size != size
+                       || (node >= 0 && s->node != node)))
+    s = s->next;
+  if (s == NULL) s = new_slab(size, node);
+  if (s == NULL) return NULL;
+  if (s->decommitted) {
+    /* Faulted back in on first access */
+    s->decommitted = false;
+    slab_free_bytes += SLAB_SIZE;
+  }
+  for (size_t i = 0; i < SLAB_BITMAP_WORDS; i++) {
+    if (s->free[i] == 0) continue;
+    int bit = __builtin_ctzll(s->free[i]);
+    s->free[i] &= s->free[i] - 1;
+    s->free_count--;
+    slab_free_bytes -= size;
+    if (s->free_count == 0) slab_list_remove(s);
+    return s->base + (i * 64 + bit) * size;
+  }
+  assert(false);
+  return NULL;
+}
+
+/* The slab of [p], NULL if [p] does not belong to a slab. */
+/* ownership required: slab_mutex */
+static slab * find_slab(void *p)
+{
+  char *base = (char *)((uintptr_t)p & ~((uintptr_t)SLAB_SIZE - 1));
+  size_t i = slab_index_search(base);
+  if (i < slab_index.len && slab_index.slabs[i]->base == base)
+    return slab_index.slabs[i];
+  return NULL;
+}
+
+/* Returns false if p does not belong to a slab. */
+/* ownership required: slab_mutex */
+static bool slab_free(void *p)
+{
+  slab *s = find_slab(p);
+  if (s == NULL) return false;
+  char *base = s->base;
+  size_t index = ((char *)p - base) / s->chunk_size;
+  s->free[index / 64] |= (uint64_t)1 << (index % 64);
+  /* It has a free chunk again */
+  if (s->free_count++ == 0) slab_list_push(s);
+  slab_free_bytes += s->chunk_size;
+  if ((size_t)s->free_count != SLAB_SIZE / s->chunk_size) return true;
+  if (slab_index.len > 1) {
+    /* Entirely free, and not the last slab: give it back */
+    slab_list_remove(s);
+    slab_index_remove(s);
+    munmap(s->base, SLAB_SIZE);
+    free(s);
+    slab_free_bytes -= SLAB_SIZE;
+  } else {
+    /* Entirely free, and the last slab: keep the mapping */
+    madvise(s->base, SLAB_SIZE, MADV_DONTNEED);
+    s->decommitted = true;
+    slab_free_bytes -= SLAB_SIZE;
+  }
+  return true;
+}
+
+#endif // USE_SLABS
+
+/* }}} */
+
+long long bxr_slab_free_bytes(void)
+{
+#if USE_SLABS
+  return load_relaxed(&slab_free_bytes);
+#else
+  return 0;
+#endif
+}
+
+pool * bxr_alloc_uninitialised_pool_on_node(size_t size, int node)
 {
   void *p = NULL;
+#if USE_SLABS
+  if (fits_in_slab(size)) {
+    bxr_mutex_lock(&slab_mutex);
+    p = slab_alloc(size, node);
+    bxr_mutex_unlock(&slab_mutex);
+    if (p != NULL) return p;
+  }
+#endif
   // TODO: portability?
   // Win32: p = _aligned_malloc(size, alignment);
   int err = posix_memalign(&p, size, size);
   assert(err != EINVAL);
   if (err == ENOMEM) return NULL;
   assert(p != NULL);
+  prefer_numa_node(p, size, node);
   return p;
 }
 
+pool * bxr_alloc_uninitialised_pool(size_t size)
+{
+  return bxr_alloc_uninitialised_pool_on_node(size, -1);
+}
+
 void bxr_free_pool(pool *p) {
+#if USE_SLABS
+  bxr_mutex_lock(&slab_mutex);
+  bool in_slab = slab_free(p);
+  bxr_mutex_unlock(&slab_mutex);
+  if (in_slab) return;
+#endif
     // Win32: _aligned_free(p);
     free(p);
 }
 
+bool bxr_decommit_pool(pool *p, size_t size, size_t keep)
+{
+#if USE_SLABS
+  /* Decommitting part of a slab would split its huge page */
+  bxr_mutex_lock(&slab_mutex);
+  bool in_slab = find_slab(p) != NULL;
+  bxr_mutex_unlock(&slab_mutex);
+  if (in_slab) return false;
+#endif
+#if defined(__linux__) || defined(__APPLE__)
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  size_t start = (keep + page - 1) & ~(page - 1);
+  if (start >= size) return true;
+#if defined(__linux__)
+  int advice = MADV_DONTNEED;
+#else
+  int advice = MADV_FREE;
+#endif
+  madvise((char *)p + start, size - start, advice);
+#else
+  (void)p; (void)size; (void)keep;
+#endif
+  return true;
+}
+
 bool bxr_initialize_mutex(pthread_mutex_t *mutex)
 {
   return 0 == pthread_mutex_init(mutex, NULL);
@@ -45,3 +421,150 @@ void bxr_mutex_unlock(pthread_mutex_t *mutex)
 {
   pthread_mutex_unlock(mutex);
 }
+
+void bxr_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex)
+{
+  pthread_cond_wait(cond, mutex);
+}
+
+void bxr_cond_broadcast(pthread_cond_t *cond)
+{
+  pthread_cond_broadcast(cond);
+}
+
+bool bxr_thread_create(pthread_t *thread, void *(*start)(void *),
+                       void *arg)
+{
+  sigset_t all, old;
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  int err = pthread_create(thread, NULL, start, arg);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  return err == 0;
+}
+
+void bxr_thread_join(pthread_t thread)
+{
+  pthread_join(thread, NULL);
+}
+
+void bxr_yield(void)
+{
+  sched_yield();
+}
+
+bool bxr_cpu_has_avx2(void)
+{
+#if BXR_SIMD_AVX2
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#else
+  return false;
+#endif
+}
+
+/* {{{ Shared memory */
+
+void * bxr_shm_create(const char *name, size_t size)
+{
+#if defined(__linux__) || defined(__APPLE__)
+  int fd = shm_open(name, O_CREAT | O_TRUNC | O_RDWR, 0644);
+  if (fd == -1) return NULL;
+  void *addr = MAP_FAILED;
+  if (ftruncate(fd, size) == 0)
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr != MAP_FAILED) return addr;
+  shm_unlink(name);
+#endif
+  return NULL;
+}
+
+void bxr_shm_remove(const char *name, void *addr, size_t size)
+{
+#if defined(__linux__) || defined(__APPLE__)
+  munmap(addr, size);
+  shm_unlink(name);
+#endif
+}
+
+/* }}} */
+
+/* {{{ Backtraces */
+
+int bxr_backtrace(void **frames, int size)
+{
+#if defined(HAS_BACKTRACE)
+  return backtrace(frames, size);
+#else
+  return 0;
+#endif
+}
+
+void bxr_print_backtrace(int fd, void *const *frames, int depth)
+{
+#if defined(HAS_BACKTRACE)
+  backtrace_symbols_fd(frames, depth, fd);
+#endif
+}
+
+/* }}} */
+
+/* {{{ Clock */
+
+static long long monotonic_ns(void)
+{
+#if defined(POSIX_CLOCK)
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (long long)t.tv_sec * (long long)1000000000 + (long long)t.tv_nsec;
+#else
+  return 0;
+#endif
+}
+
+/* Set once by `bxr_clock_init` */
+static bool use_tsc = false;
+static long long origin_ticks, origin_ns;
+
+void bxr_clock_init(void)
+{
+#if USE_TSC && defined(POSIX_CLOCK)
+  unsigned eax, ebx, ecx, edx;
+  /* Invariant TSC: constant rate, synchronised between cores */
+  use_tsc = __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)
+    && (edx & (1 << 8));
+#endif
+  origin_ns = monotonic_ns();
+  origin_ticks = bxr_clock_ticks();
+}
+
+long long bxr_clock_ticks(void)
+{
+#if USE_TSC
+  if (use_tsc) return (long long)__rdtsc();
+#endif
+  return monotonic_ns();
+}
+
+double bxr_ns_per_tick(void)
+{
+  if (!use_tsc) return 1.0;
+  long long ticks = bxr_clock_ticks() - origin_ticks;
+  long long ns = monotonic_ns() - origin_ns;
+  if (ticks <= 0 || ns <= 0) return 1.0;
+  return (double)ns / (double)ticks;
+}
+
+/* }}} */
+
+bool bxr_initialize_thread_key(pthread_key_t *key,
+                               void (*destructor)(void *))
+{
+  return 0 == pthread_key_create(key, destructor);
+}
+
+bool bxr_set_thread_key(pthread_key_t key, void *v)
+{
+  return 0 == pthread_setspecific(key, v);
+}
@@ -59,6 +59,7 @@ typedef intnat value;
 #define incr(a) (atomic_fetch_add_explicit((a), 1, memory_order_relaxed))
 #define decr(a) (atomic_fetch_add_explicit((a), -1, memory_order_relaxed))
 #define decr_release(a) (atomic_fetch_add_explicit((a), -1, memory_order_release))
+#define sub_release(a, n) (atomic_fetch_sub_explicit((a), (n), memory_order_release))
 
 typedef pthread_mutex_t mutex_t;
 #define BXR_MUTEX_INITIALIZER PTHREAD_MUTEX_INITIALIZER;
@@ -67,6 +68,81 @@ bool bxr_initialize_mutex(mutex_t *mutex);
 void bxr_mutex_lock(mutex_t *mutex);
 void bxr_mutex_unlock(mutex_t *mutex);
 
+typedef pthread_cond_t cond_t;
+#define BXR_COND_INITIALIZER PTHREAD_COND_INITIALIZER
+
+void bxr_cond_wait(cond_t *cond, mutex_t *mutex);
+void bxr_cond_broadcast(cond_t *cond);
+
+typedef pthread_t thread_t;
+
+/* Start a thread running `start(arg)`, with all signals blocked so
+   that they keep being delivered to OCaml threads. */
+bool bxr_thread_create(thread_t *thread, void *(*start)(void *),
+                       void *arg);
+void bxr_thread_join(thread_t thread);
+
+/* Give up the processor to other threads. */
+void bxr_yield(void);
+
+/* Hint for spin-wait loops. */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define bxr_cpu_relax() __builtin_ia32_pause()
+#elif defined(__GNUC__) && defined(__aarch64__)
+#define bxr_cpu_relax() __asm__ __volatile__("yield" ::: "memory")
+#else
+#define bxr_cpu_relax() ((void)0)
+#endif
+
+/* Hint that [p] is about to be read. */
+#if defined(__GNUC__)
+#define bxr_prefetch(p) __builtin_prefetch((p))
+#else
+#define bxr_prefetch(p) ((void)(p))
+#endif
+
+#ifndef ENABLE_BOXROOT_SIMD
+#define ENABLE_BOXROOT_SIMD 1
+#endif
+
+/* Vector scanning kernels, selected at run time according to the
+   CPU. */
+#if ENABLE_BOXROOT_SIMD && defined(__GNUC__) && defined(__x86_64__)
+#define BXR_SIMD_AVX2 1
+#else
+#define BXR_SIMD_AVX2 0
+#endif
+
+bool bxr_cpu_has_avx2(void);
+
+/* Clock for durations measured inside STW sections, in ticks of the
+   TSC when it is invariant, otherwise in nanoseconds of the
+   monotonic clock (or always 0 if there is none). `bxr_clock_init`
+   must be called once before; `bxr_ns_per_tick` is estimated from the
+   time elapsed since then. */
+void bxr_clock_init(void);
+long long bxr_clock_ticks(void);
+double bxr_ns_per_tick(void);
+
+/* Create (or truncate) the shared memory file `name`, of size
+   `size`, and map it. NULL on failure. */
+void * bxr_shm_create(const char *name, size_t size);
+void bxr_shm_remove(const char *name, void *addr, size_t size);
+
+/* Store the return addresses of the current call stack in
+   `frames[0..size)`, and return their number (0 if unsupported). */
+int bxr_backtrace(void **frames, int size);
+/* Write the symbolic names of `frames` to the file descriptor `fd` */
+void bxr_print_backtrace(int fd, void *const *frames, int depth);
+
+typedef pthread_key_t thread_key_t;
+
+/* `destructor` is called with the thread's value of the key at thread
+   exit, if non-NULL. */
+bool bxr_initialize_thread_key(thread_key_t *key,
+                               void (*destructor)(void *));
+bool bxr_set_thread_key(thread_key_t key, void *v);
+
 /* Check integrity of pool structure after each scan, and print
    additional statistics? (slow)
    This can be enabled by passing BOXROOT_DEBUG=1 as argument. */
@@ -74,6 +150,15 @@ void bxr_mutex_unlock(mutex_t *mutex);
 #define BOXROOT_DEBUG false
 #endif
 
+/* Record the operations on boxroots for replay (see
+   `boxroot_trace_start`)? When set, the fast paths test whether a
+   trace is being written. Code calling Boxroot must be compiled with
+   the same setting for its own (inlined) fast paths to be recorded.
+   This can be enabled by passing BOXROOT_TRACE=1 as argument. */
+#ifndef BOXROOT_TRACE
+#define BOXROOT_TRACE false
+#endif
+
 #if BOXROOT_DEBUG
 #define DEBUGassert(x) assert(x)
 #else
@@ -84,10 +169,29 @@ void bxr_mutex_unlock(mutex_t *mutex);
 #endif
 #endif
 
+#define BXR_MAX_NUMA_NODES 64
+
+/* The NUMA node of the CPU running the calling thread, in [0,
+   BXR_MAX_NUMA_NODES). 0 if unknown, or if NUMA awareness is
+   disabled. */
+int bxr_numa_node(void);
+
 typedef struct pool pool;
 
 pool* bxr_alloc_uninitialised_pool(size_t size);
+/* Same, placing the memory of the pool preferably on NUMA node
+   `node`. */
+pool* bxr_alloc_uninitialised_pool_on_node(size_t size, int node);
 void bxr_free_pool(pool *p);
+/* Give back to the OS the memory of the pool `p` of size `size`,
+   except for its first `keep` bytes (rounded up to a page). The
+   contents of the rest become unspecified. Returns false, doing
+   nothing, if `p` belongs to a slab: the slab is given back as a
+   whole once all its pools are freed. */
+bool bxr_decommit_pool(pool *p, size_t size, size_t keep);
+/* Bytes of memory committed to slabs but not handed out as pools:
+   the free chunks of the slabs that have not been decommitted. */
+long long bxr_slab_free_bytes(void);
 
 #endif // CAML_INTERNALS
 
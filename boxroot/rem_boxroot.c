@@ -649,6 +649,17 @@ static int boxroot_used()
   return (pools != NULL || stats.ring_operations > 0);
 }
 
+/* Every collection scans all the roots */
+void rem_boxroot_get_scan_counters(struct boxroot_scan_counters *c)
+{
+  c->minor_collections = stats.minor_collections;
+  c->major_collections = stats.major_collections;
+  c->scanning_work_minor = 0;
+  c->scanning_work_major = stats.total_scanning_work;
+  c->minor_time = 0;
+  c->major_time = stats.total_major_time;
+}
+
 void rem_boxroot_print_stats()
 {
   printf("minor collections: %d\n"
@@ -779,7 +790,7 @@ int rem_boxroot_setup()
   stats = empty_stats;
   pools = NULL;
   full_pools = NULL;
-  bxr_setup_hooks(&scanning_callback, NULL);
+  bxr_setup_hooks(&scanning_callback, NULL, NULL);
   // we are done
   setup = 1;
   CRITICAL_SECTION_END();
@@ -3,6 +3,7 @@
 #define REM_BOXROOT_H
 
 #include <caml/mlvalues.h>
+#include "boxroot_stats.h"
 
 typedef struct rem_boxroot_private* rem_boxroot;
 
@@ -51,4 +52,7 @@ void rem_boxroot_teardown();
 /* Show some statistics on the standard output. */
 void rem_boxroot_print_stats();
 
+/* Fill `c` with the scanning counters (see boxroot_stats.h). */
+void rem_boxroot_get_scan_counters(struct boxroot_scan_counters *c);
+
 #endif // REM_BOXROOT_H
@@ -0,0 +1,44 @@
+(* Enabling sampling, then creating more boxroots than a pool holds,
+   must not loop in the slow path. About one in [rate] creations must
+   be sampled, including with boxroot_create_n, and deleting the
+   boxroots must drop their samples. *)
+
+external sample_creations : int ref -> int -> int -> int -> unit
+  = "test_sample_creations"
+
+external sample_counts : int ref -> int -> int -> int -> int * int
+  = "test_sample_counts"
+
+let check_counts v ~rate ~n ~batch =
+  let created, deleted = sample_counts v rate n batch in
+  let expected = n / rate in
+  if created < expected / 2 || created > 2 * expected || deleted <> 0
+  then (
+    Printf.printf
+      "batch %d: %d samples for %d creations at 1/%d, %d after deletion\n"
+      batch
+      created
+      n
+      rate
+      deleted;
+    exit 1)
+;;
+
+let () =
+  let v = ref 0 in
+  let n = 100_000 in
+  (* Before the first creation of the domain *)
+  sample_creations v 1 0 n;
+  (* After some creations, once the countdown is running *)
+  sample_creations v 100 1000 n;
+  (* Back and forth *)
+  sample_creations v 7 50_000 n;
+  Gc.full_major ();
+  sample_creations v 0 0 n;
+  (* One by one, then by batches longer and shorter than the
+     countdown *)
+  List.iter
+    (fun batch -> check_counts v ~rate:100 ~n:(2 * n) ~batch)
+    [ 0; 1000; 37 ];
+  print_endline "ok"
+;;
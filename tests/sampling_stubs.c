@@ -0,0 +1,102 @@
+/* SPDX-License-Identifier: MIT */
+#define CAML_NAME_SPACE
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <caml/mlvalues.h>
+#include <caml/alloc.h>
+#include <caml/fail.h>
+#include "../boxroot/boxroot.h"
+
+/* Create [n] boxroots to [v] with sampling rate [rate] (0 to leave
+   it unchanged), after [before] creations, then delete them all. */
+value test_sample_creations(value v, value rate, value before, value n)
+{
+  long total = Long_val(n);
+  boxroot *rs = malloc(total * sizeof(boxroot));
+  if (rs == NULL) caml_raise_out_of_memory();
+  for (long i = 0; i < total; i++) {
+    if (i == Long_val(before) && Int_val(rate) != 0)
+      boxroot_set_sampling(Int_val(rate));
+    rs[i] = boxroot_create(v);
+    if (rs[i] == NULL) {
+      for (long j = 0; j < i; j++) boxroot_delete(rs[j]);
+      free(rs);
+      caml_failwith("boxroot_create");
+    }
+  }
+  int fd = open("/dev/null", O_WRONLY);
+  if (fd >= 0) {
+    boxroot_dump_profile(fd, 10);
+    close(fd);
+  }
+  for (long i = 0; i < total; i++) boxroot_delete(rs[i]);
+  free(rs);
+  boxroot_set_sampling(0);
+  return Val_unit;
+}
+
+/* The number of live samples, read from the first line of the
+   profile. */
+static long live_samples(void)
+{
+  FILE *f = tmpfile();
+  if (f == NULL) caml_failwith("tmpfile");
+  boxroot_dump_profile(fileno(f), 0);
+  rewind(f);
+  long n = -1;
+  if (fscanf(f, "%ld live samples", &n) != 1) n = -1;
+  fclose(f);
+  if (n < 0) caml_failwith("boxroot_dump_profile");
+  return n;
+}
+
+/* Create [n] boxroots to [v] with sampling rate [rate], by batches of
+   [batch] with boxroot_create_n, or one by one if [batch] is 0, then
+   delete them likewise. Returns the number of live samples after the
+   creations and after the deletions. Sampling is disabled on return. */
+value test_sample_counts(value v, value rate, value n, value batch)
+{
+  long total = Long_val(n), b = Long_val(batch);
+  boxroot *rs = malloc(total * sizeof(boxroot));
+  value *vs = malloc((b > 0 ? b : 1) * sizeof(value));
+  if (rs == NULL || vs == NULL) {
+    free(rs);
+    free(vs);
+    caml_raise_out_of_memory();
+  }
+  boxroot_set_sampling(Int_val(rate));
+  long created = 0;
+  bool ok = true;
+  while (ok && created < total) {
+    if (b == 0) {
+      rs[created] = boxroot_create(v);
+      ok = rs[created] != NULL;
+      created += ok;
+    } else {
+      long k = total - created < b ? total - created : b;
+      for (long j = 0; j < k; j++) vs[j] = v;
+      ok = boxroot_create_n(vs, k, rs + created);
+      if (ok) created += k;
+    }
+  }
+  long after_create = live_samples();
+  if (b == 0) {
+    for (long i = 0; i < created; i++) boxroot_delete(rs[i]);
+  } else {
+    for (long i = 0; i < created; i += b)
+      boxroot_delete_n(rs + i, created - i < b ? created - i : b);
+  }
+  long after_delete = live_samples();
+  boxroot_set_sampling(0);
+  free(rs);
+  free(vs);
+  if (!ok) caml_failwith("boxroot_create");
+  value res = caml_alloc_tuple(2);
+  Store_field(res, 0, Val_long(after_create));
+  Store_field(res, 1, Val_long(after_delete));
+  return res;
+}
@@ -0,0 +1,12 @@
+(* The vector scanning kernels must call the GC action on the same
+   slots as the scalar ones, on pools mixing free slots, immediates
+   (including odd values inside the young range), young blocks and
+   old blocks. Trivially true on CPUs without the vector
+   instructions. *)
+
+external check_scan_kernels : unit -> bool = "test_check_scan_kernels"
+
+let () =
+  assert (check_scan_kernels ());
+  print_endline "ok"
+;;
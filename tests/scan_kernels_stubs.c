@@ -0,0 +1,14 @@
+/* SPDX-License-Identifier: MIT */
+#define CAML_NAME_SPACE
+
+#include <stdbool.h>
+
+#include <caml/mlvalues.h>
+
+/* Internal to boxroot */
+bool bxr_check_scan_kernels(void);
+
+value test_check_scan_kernels(value unit)
+{
+  return Val_bool(bxr_check_scan_kernels());
+}
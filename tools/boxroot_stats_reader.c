@@ -0,0 +1,206 @@
+/* SPDX-License-Identifier: MIT */
+/* Print the statistics exported by `boxroot_export_stats`.
+
+   Usage: boxroot_stats_reader [-p] [-d] NAME
+     -p  Prometheus text exposition format
+     -d  also show the counters of each domain */
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../boxroot/boxroot_stats.h"
+
+#define FIELD(name) { #name, offsetof(struct boxroot_stats, name) }
+
+static const struct { const char *name; size_t offset; } fields[] = {
+  FIELD(minor_collections),
+  FIELD(major_collections),
+  FIELD(total_create_young),
+  FIELD(total_create_old),
+  FIELD(total_create_slow),
+  FIELD(total_delete_young),
+  FIELD(total_delete_old),
+  FIELD(total_delete_slow),
+  FIELD(total_modify),
+  FIELD(total_modify_slow),
+  FIELD(total_gc_pool_rings),
+  FIELD(total_remote_flushes),
+  FIELD(total_delete_lockless),
+  FIELD(total_lockless_backoffs),
+  FIELD(total_parallel_scans),
+  FIELD(total_scanning_work_minor),
+  FIELD(total_scanning_work_major),
+  FIELD(young_slots_skipped),
+  FIELD(young_hit_young),
+  FIELD(young_hit_gen),
+  FIELD(total_deaths),
+  FIELD(deaths_before_minor),
+  FIELD(total_minor_time),
+  FIELD(total_major_time),
+  FIELD(peak_minor_time),
+  FIELD(peak_major_time),
+  FIELD(minor_time_p50),
+  FIELD(minor_time_p99),
+  FIELD(minor_time_p999),
+  FIELD(major_time_p50),
+  FIELD(major_time_p99),
+  FIELD(major_time_p999),
+  FIELD(total_alloced_pools),
+  FIELD(total_emptied_pools),
+  FIELD(total_freed_pools),
+  FIELD(total_decommitted_pools),
+  FIELD(total_recommitted_pools),
+  FIELD(decommitted_pools),
+  FIELD(free_pools_target),
+  FIELD(sparse_pools),
+  FIELD(ring_operations),
+  FIELD(live_pools),
+  FIELD(peak_pools),
+  FIELD(free_pools_min),
+  FIELD(free_pools_max),
+  FIELD(committed_bytes),
+};
+
+#define NUM_FIELDS (sizeof(fields) / sizeof(fields[0]))
+_Static_assert(NUM_FIELDS * sizeof(long long) == sizeof(struct boxroot_stats),
+               "missing fields");
+
+#define BUCKETS BOXROOT_SCAN_HISTOGRAM_BUCKETS
+
+static long long * field(struct boxroot_stats *s, size_t i)
+{
+  return (long long *)((char *)s + fields[i].offset);
+}
+
+static int is_peak(size_t i)
+{
+  return strncmp(fields[i].name, "peak_", 5) == 0;
+}
+
+/* Upper bound in nanoseconds of the bucket of the [q]-quantile */
+static long long quantile(const long long *counts, const long long *bounds,
+                          double ns_per_tick, double q)
+{
+  long long total = 0;
+  for (int i = 0; i < BUCKETS; i++) total += counts[i];
+  if (total == 0) return 0;
+  long long rank = (long long)(q * (double)total);
+  if (rank >= total) rank = total - 1;
+  long long seen = 0;
+  int i = 0;
+  for (; i < BUCKETS - 1; i++) {
+    seen += counts[i];
+    if (seen > rank) break;
+  }
+  return (long long)((double)bounds[i + 1] * ns_per_tick);
+}
+
+static void print_stats(struct boxroot_stats *s, int prometheus,
+                        const char *label)
+{
+  for (size_t i = 0; i < NUM_FIELDS; i++) {
+    if (prometheus)
+      printf("boxroot_%s%s %lld\n", fields[i].name, label, *field(s, i));
+    else
+      printf("%s%s: %lld\n", fields[i].name, label, *field(s, i));
+  }
+}
+
+int main(int argc, char **argv)
+{
+  int prometheus = 0, domains = 0, opt;
+  while ((opt = getopt(argc, argv, "pd")) != -1) {
+    if (opt == 'p') prometheus = 1;
+    else if (opt == 'd') domains = 1;
+    else goto usage;
+  }
+  if (optind != argc - 1) goto usage;
+
+  char name[256];
+  const char *arg = argv[optind];
+  snprintf(name, sizeof(name), "%s%s", arg[0] == '/' ? "" : "/", arg);
+  int fd = shm_open(name, O_RDONLY, 0);
+  struct stat st;
+  if (fd == -1 || fstat(fd, &st) == -1) {
+    perror(name);
+    return 1;
+  }
+  char *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    perror("mmap");
+    return 1;
+  }
+  struct boxroot_shm_header *h = (struct boxroot_shm_header *)base;
+  if ((size_t)st.st_size < sizeof(*h)
+      || h->magic != BOXROOT_SHM_MAGIC
+      || h->version != BOXROOT_SHM_VERSION
+      || h->stats_size != sizeof(struct boxroot_stats)
+      || h->slot_size != sizeof(struct boxroot_shm_slot)
+      || (size_t)st.st_size < BOXROOT_SHM_SLOTS_OFFSET
+                              + (size_t)h->num_slots * h->slot_size) {
+    fprintf(stderr, "%s: incompatible layout\n", name);
+    return 1;
+  }
+
+  /* The header: `seq` and the fields after it */
+  struct boxroot_shm_header hdr;
+  size_t from = offsetof(struct boxroot_shm_header, ns_per_tick);
+  boxroot_shm_read(&h->seq, (char *)&hdr + from, (char *)h + from,
+                   sizeof(hdr) - from);
+
+  struct boxroot_stats total = { 0 };
+  long long minor[BUCKETS] = { 0 }, major[BUCKETS] = { 0 };
+  struct boxroot_shm_slot *slot = malloc(sizeof(*slot));
+  if (slot == NULL) return 1;
+  for (uint32_t d = 0; d < h->num_slots; d++) {
+    struct boxroot_shm_slot *src = (struct boxroot_shm_slot *)
+      (base + BOXROOT_SHM_SLOTS_OFFSET + (size_t)d * h->slot_size);
+    size_t from = offsetof(struct boxroot_shm_slot, stats);
+    boxroot_shm_read(&src->seq, (char *)slot + from, (char *)src + from,
+                     sizeof(*slot) - from);
+    for (size_t i = 0; i < NUM_FIELDS; i++) {
+      long long v = *field(&slot->stats, i);
+      if (!is_peak(i)) *field(&total, i) += v;
+      else if (v > *field(&total, i)) *field(&total, i) = v;
+    }
+    for (int i = 0; i < BUCKETS; i++) {
+      minor[i] += slot->minor_histogram[i];
+      major[i] += slot->major_histogram[i];
+    }
+    if (domains && (slot->stats.minor_collections != 0
+                    || slot->stats.major_collections != 0
+                    || slot->stats.total_alloced_pools != 0)) {
+      char label[32];
+      snprintf(label, sizeof(label),
+               prometheus ? "{domain=\"%d\"}" : " (domain %d)", (int)d - 1);
+      print_stats(&slot->stats, prometheus, label);
+    }
+  }
+  double ns = hdr.ns_per_tick;
+  const long long *bounds = h->bucket_bounds;
+  total.minor_time_p50 = quantile(minor, bounds, ns, 0.5);
+  total.minor_time_p99 = quantile(minor, bounds, ns, 0.99);
+  total.minor_time_p999 = quantile(minor, bounds, ns, 0.999);
+  total.major_time_p50 = quantile(major, bounds, ns, 0.5);
+  total.major_time_p99 = quantile(major, bounds, ns, 0.99);
+  total.major_time_p999 = quantile(major, bounds, ns, 0.999);
+  total.live_pools = hdr.live_pools;
+  total.peak_pools = hdr.peak_pools;
+  total.free_pools_min = hdr.free_pools_min;
+  total.free_pools_max = hdr.free_pools_max;
+  total.committed_bytes = hdr.committed_bytes;
+  if (!prometheus) printf("pid: %lld\n", (long long)h->pid);
+  print_stats(&total, prometheus, "");
+  return 0;
+
+ usage:
+  fprintf(stderr, "usage: %s [-p] [-d] NAME\n", argv[0]);
+  return 2;
+}